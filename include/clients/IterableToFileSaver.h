@@ -2,40 +2,69 @@
 #define MANDEYE_MULTISENSOR_ITERABLETOFILESAVER_H
 
 #include <utility>
-#include <functional>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <string>
+#include <vector>
 
 namespace mandeye
 {
 
-template <template <typename...> class Container, typename... Args>
+//! Writes a container as text, one line per element.
+//! Formatter is a type with
+//!   size_t maxLength(const value_type&) const; - upper bound of the line, without the newline
+//!   char* operator()(const value_type&, char* out) const; - writes the line at out, returns its end
+//! Lines are formatted straight into a block that goes to the file when full.
+template <typename Container, typename Formatter>
 class IterableToFileSaver
 {
 public:
-	using Formatter = std::function<std::string (typename Container<Args...>::value_type)>;
+	//! size of the blocks written to the file
+	static constexpr size_t WriteBufferSize = 1 << 20;
 
-	IterableToFileSaver(std::string fileExtension, std::string fileIdentifier, Formatter formatter)
-		: fileExtension(std::move(fileExtension)), fileIdentifier(std::move(fileIdentifier)), formatter(formatter) {};
-	void setBuffer(Container<Args...> newBuffer) {
+	IterableToFileSaver(std::string fileExtension, std::string fileIdentifier, Formatter formatter = {})
+		: fileExtension(std::move(fileExtension)), fileIdentifier(std::move(fileIdentifier)), formatter(std::move(formatter)) {};
+	void setBuffer(Container&& newBuffer) {
 		buffer = std::move(newBuffer);
 	};
 
-	void saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) {
+	bool saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) {
 		std::ofstream outs;
 		bool retFileOpen = getSavingStream(outs, directory, chunk);
 		if (!retFileOpen)
-			return;
-		for(auto& elem : buffer)
-			outs << formatter(elem) << std::endl;
+			return false;
+		std::vector<char> block(WriteBufferSize);
+		size_t used = 0;
+		for(const auto& elem : buffer)
+		{
+			const size_t length = formatter.maxLength(elem) + 1;
+			if(used + length > block.size())
+			{
+				outs.write(block.data(), used);
+				used = 0;
+				if(length > block.size())
+					block.resize(length);
+			}
+			char* end = formatter(elem, block.data() + used);
+			*end++ = '\n';
+			used = end - block.data();
+		}
+		outs.write(block.data(), used);
 		outs.close();
+		if(outs.fail())
+		{
+			std::cerr << "Error writing " << fileIdentifier << " chunk " << chunk << std::endl;
+			return false;
+		}
+		return true;
 	}
 
 private:
 	std::string fileExtension;
 	std::string fileIdentifier;
-	Container<Args...> buffer;
+	Container buffer;
 	Formatter formatter;
 
 	bool getSavingStream(std::ofstream& out, const std::string& directory, int chunkNumber) {
@@ -45,7 +74,7 @@ private:
 		snprintf(filename, 64, "%s%04d.%s", fileIdentifier.c_str(), chunkNumber, fileExtension.c_str());
 		using namespace std::filesystem;
 		path outFile = path(directory) / path(filename);
-		out.open(outFile);
+		out.open(outFile, std::ios::binary);
 		if(out.fail())
 		{
 			std::cerr << "Error opening file '" << filename << "' !!" << std::endl;
@@ -56,6 +85,19 @@ private:
 	}
 };
 
+//! Formatter writing each string as it is
+struct StringLineFormatter
+{
+	size_t maxLength(const std::string& line) const
+	{
+		return line.size();
+	}
+	char* operator()(const std::string& line, char* out) const
+	{
+		std::memcpy(out, line.data(), line.size());
+		return out + line.size();
+	}
+};
 
 } // namespace mandeye
 
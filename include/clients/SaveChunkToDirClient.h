@@ -2,17 +2,22 @@
 #define MANDEYE_MULTISENSOR_SAVECHUNKTODIRCLIENT_H
 
 #include <filesystem>
+#include <functional>
 
 namespace mandeye
 {
 
+//! Saves one dumped chunk of a client, it owns the chunk's data.
+//! Returns false when a file of the chunk could not be written completely, the chunk is quarantined then.
+using DumpedChunk = std::function<bool(const std::filesystem::path& directory, int chunk)>;
+
 class SaveChunkToDirClient
 {
 public:
 	//! Used to sync more clients, you dump the chunk for each client and then save it to the directory
-	//!  Because dumping to directory is slower and there is no sync between clients
-	virtual void dumpChunkInternally() = 0;
-	virtual void saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) = 0;
+	//!  Because dumping to directory is slower and there is no sync between clients.
+	//!  Saving runs on the chunk writer thread while the next chunks are recorded, so the dump shares nothing with the client.
+	virtual DumpedChunk dumpChunk() = 0;
 };
 
 } // namespace mandeye
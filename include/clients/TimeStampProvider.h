@@ -8,6 +8,8 @@ namespace mandeye
 class TimeStampProvider
 {
 public:
-	virtual uint64_t getTimestamp() = 0;
+	//! Returns the current timestamp in nanoseconds.
+	//! Called for every camera frame and GNSS line, implementations must not block.
+	virtual uint64_t getTimestamp() noexcept = 0;
 };
 } // namespace mandeye
\ No newline at end of file
@@ -9,7 +9,7 @@ public:
 	//! Set timestamp provider
 	void SetTimeStampProvider(std::shared_ptr<TimeStampProvider> timeStampProvider);
 	//! Returns the current timestamp in nanoseconds
-	uint64_t GetTimeStamp();
+	uint64_t GetTimeStamp() noexcept;
 protected:
 	//! The timestamp provider
 	std::shared_ptr<TimeStampProvider> m_timeStampProvider;
@@ -30,8 +30,7 @@ class CamerasClient : public TimeStampReceiver, public SaveChunkToDirClient, pub
 	public:
 		CamerasClient(const std::string& savingMediaPath, ThreadMap& threadsList); // threadsList for joining the threads at shutdown
 		void receiveImages();
-		void saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) override;
-		void dumpChunkInternally() override;
+		DumpedChunk dumpChunk() override;
 		void startLog() override;
 		void stopLog() override;
 
@@ -44,7 +43,6 @@ class CamerasClient : public TimeStampReceiver, public SaveChunkToDirClient, pub
 		std::vector<ImageInfo> savedImagesBuffer;
 		std::atomic<bool> isLogging{false};
 		int tmpImageCounter = 0;
-		std::vector<ImageInfo> dumpBuffer; // needed by SaveChunkToDirClient
 		utils::BlockingQueue<StampedImage> writeBuffer;
 
 		void initializeVideoCapture(int index);
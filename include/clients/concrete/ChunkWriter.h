@@ -0,0 +1,88 @@
+#ifndef MANDEYE_MULTISENSOR_CHUNKWRITER_H
+#define MANDEYE_MULTISENSOR_CHUNKWRITER_H
+
+#include "clients/JsonStateProducer.h"
+#include "clients/SaveChunkToDirClient.h"
+#include "utils/chunk_journal.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <json.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Saves dumped chunks on its own thread, so the state machine keeps running while a chunk is written.
+//! At most `depth` chunks are dumped and not saved yet; with depth 1 chunk N+1 records while chunk N is saved.
+//! A chunk is written to a staging directory, synced and then committed to the session (chunk_journal.h).
+class ChunkWriter : public JsonStateProducer
+{
+public:
+	using CommitListener = std::function<void(const std::vector<std::filesystem::path>& files)>;
+
+	//! @param repository partial chunks left there by a power loss are recovered first
+	//! @param busy called with true when the writer starts saving, false when nothing is left to save
+	ChunkWriter(const std::filesystem::path& repository, size_t depth, std::function<void(bool)> busy);
+	~ChunkWriter();
+
+	//! saves the chunks still queued and stops the writer thread
+	void finish();
+
+	//! Takes a slot for the next chunk, call before dumping the clients.
+	//! When all slots are taken it waits if `wait`, otherwise returns false and the chunk keeps recording.
+	bool reserve(bool wait);
+
+	//! queues the dumps of a chunk for the slot taken by reserve
+	void enqueue(std::vector<DumpedChunk> dumps, const std::string& directory, int chunk);
+
+	//! chunks dumped and not saved yet
+	size_t pending();
+
+	//! called on the writer thread with the files of every committed chunk, add before the first chunk
+	void addCommitListener(CommitListener listener);
+
+	nlohmann::json produceStatus() override;
+	std::string getJsonName() override;
+
+private:
+	struct Job
+	{
+		std::vector<DumpedChunk> dumps;
+		std::string directory;
+		int chunk;
+		std::chrono::steady_clock::time_point dumped;
+	};
+
+	void writerThread();
+
+	const size_t m_depth;
+	const std::function<void(bool)> m_busy;
+	const ChunkRecovery m_recovery;
+	std::vector<CommitListener> m_commitListeners;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<Job> m_queue; // guarded by m_mutex
+	size_t m_pending{0}; // reserved, queued and saving chunks, guarded by m_mutex
+	int m_savingChunk{-1}; // guarded by m_mutex
+	bool m_backpressured{false}; // guarded by m_mutex, a chunk is waiting for a slot
+	uint64_t m_backpressureEvents{0}; // guarded by m_mutex
+	uint64_t m_saved{0}; // guarded by m_mutex
+	uint64_t m_failed{0}; // chunks quarantined because a file failed to save or sync, guarded by m_mutex
+	double m_lastLatency{0}; // dump to saved, seconds, guarded by m_mutex
+	double m_maxLatency{0}; // guarded by m_mutex
+	double m_lastSave{0}; // client jobs of the last chunk, seconds, guarded by m_mutex
+	double m_lastSync{0}; // syncfs and commit of the last chunk, seconds, guarded by m_mutex
+	double m_maxSync{0}; // guarded by m_mutex
+	bool m_done{false}; // guarded by m_mutex
+	std::thread m_thread;
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_CHUNKWRITER_H
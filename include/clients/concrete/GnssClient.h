@@ -37,8 +37,7 @@ public:
 	//! Retrieve all data from the buffer, in form of CSV lines
 	std::deque<std::string> retrieveData();
 
-	void saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) override;
-	void dumpChunkInternally() override;
+	DumpedChunk dumpChunk() override;
 
 private:
 	std::mutex m_bufferMutex;
@@ -51,7 +50,6 @@ private:
 	std::thread m_serialPortThread;
 	std::string m_portName;
 	int m_baudRate {0};
-	IterableToFileSaver<std::deque, std::string> bufferSaver;
 	void worker();
 
 	bool init_succes{false};
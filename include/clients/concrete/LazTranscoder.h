@@ -0,0 +1,59 @@
+#ifndef MANDEYE_MULTISENSOR_LAZTRANSCODER_H
+#define MANDEYE_MULTISENSOR_LAZTRANSCODER_H
+
+#include "clients/JsonStateProducer.h"
+#include "utils/save_laz.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <json.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mandeye
+{
+
+//! Converts raw point files (saveRawPoints) to LAZ in the background, only while `canRun` returns true.
+//! Runs at the lowest CPU priority, a chunk being converted when scanning starts is finished first.
+class LazTranscoder : public JsonStateProducer
+{
+public:
+	//! @param repository searched for raw point files left by an earlier run
+	//! @param canRun normally: the device is IDLE
+	LazTranscoder(const std::filesystem::path& repository, std::function<bool()> canRun, unsigned threads, LasFormat format);
+	~LazTranscoder();
+
+	//! queues a raw point file, lidarNNNN.mdpts becomes lidarNNNN.laz, or lidarNNNN.copc.laz
+	void enqueue(const std::filesystem::path& rawFile);
+
+	nlohmann::json produceStatus() override;
+	std::string getJsonName() override;
+
+private:
+	void transcoderThread();
+	bool transcode(const std::filesystem::path& rawFile);
+
+	const std::function<bool()> m_canRun;
+	const unsigned m_threads;
+	const LasFormat m_format;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<std::filesystem::path> m_queue; // guarded by m_mutex
+	std::filesystem::path m_current; // guarded by m_mutex
+	uint64_t m_queuedBytes{0}; // guarded by m_mutex
+	bool m_done{false}; // guarded by m_mutex
+
+	std::atomic<uint64_t> m_transcoded{0};
+	std::atomic<uint64_t> m_failed{0};
+	std::atomic<uint64_t> m_points{0};
+	std::atomic<uint64_t> m_savedBytes{0}; // raw minus LAZ size of the transcoded files
+	std::thread m_thread;
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_LAZTRANSCODER_H
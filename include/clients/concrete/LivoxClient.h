@@ -6,7 +6,22 @@
 #include "clients/LoggerClient.h"
 #include "clients/SaveChunkToDirClient.h"
 #include "clients/TimeStampProvider.h"
+#include "clients/concrete/LazTranscoder.h"
 #include "livox_types.h"
+#include "utils/ClockModel.h"
+#include "utils/SensorClock.h"
+#include "utils/chunk_spill.h"
+#include "utils/imu_log.h"
+#include "utils/livox_recording.h"
+#include "utils/point_filter.h"
+#include "utils/save_laz.h"
+#include "utils/voxel_downsampler.h"
+#include "utils/SpscRing.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <json.hpp>
 #include <livox_lidar_def.h>
 #include <mutex>
@@ -15,10 +30,30 @@
 namespace mandeye
 {
 
+//! LivoxClient settings, filled from the environment in main
+struct LivoxClientConfig
+{
+	//! chunks keep the raw point packets and points are expanded only when the chunk is saved
+	bool deferExpansion{false};
+	PointFilterConfig pointFilter;
+	VoxelGridConfig voxelGrid;
+	LivoxMemoryBudget memoryBudget;
+	//! threads compressing a chunk, 1 keeps the single threaded writer
+	unsigned lazThreads{1};
+	//! compresses points to LAZ while scanning, in the directory of the memory budget. Ignored with deferred expansion.
+	bool streamLaz{false};
+	//! point record layout of the saved chunks
+	LasFormat lasFormat{LasFormat::Las12Format1};
+	//! saves IMU chunks as imuNNNN.mdimu (saveImuBinary) instead of csv
+	bool binaryImu{false};
+};
+
 class LivoxClient : public SaveChunkToDirClient, public TimeStampProvider, public LoggerClient, public JsonStateProducer
 {
+	friend class LivoxReplaySource; // drives the SDK callbacks
 public:
-	LivoxClient();
+	explicit LivoxClient(const LivoxClientConfig& config = {});
+	~LivoxClient();
 
 	nlohmann::json produceStatus() override;
 	std::string getJsonName() override;
@@ -26,69 +61,289 @@ public:
 	//! starts LivoxSDK2, interface is IP of listen interface (IP of network cards with Livox connected
 	bool startListener(const std::string& interfaceIp);
 
+	//! starts the client without LivoxSDK2, packets are fed by a LivoxReplaySource
+	bool startReplay();
+
+	//! records every packet and lidar info the SDK delivers, must be set before startListener
+	void setRecorder(std::shared_ptr<LivoxPacketRecorder> recorder);
+
+	//! saves chunks as raw point files and leaves the LAZ compression to the transcoder
+	void setTranscoder(std::shared_ptr<LazTranscoder> transcoder);
+
 	//! Start log to memory data from Lidar and IMU
 	void startLog() override;
 
 	//! Stops log to memory data from Lidar and IMU
 	void stopLog() override;
 
-	std::pair<LivoxPointsBufferPtr, LivoxIMUBufferPtr> retrieveData();
+	LivoxChunk retrieveData();
 
 	//! Return current mapping from serial number to lidar id
 	std::unordered_map<uint32_t, std::string> getSerialNumberToLidarIdMapping() const;
 
 	// TimeStampProvider overrides ...
-	uint64_t getTimestamp() override;
+	uint64_t getTimestamp() noexcept override;
 
 	// periodically ask lidars for status
 	void testThread();
 
-	void saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) override;
-	void dumpChunkInternally() override;
+	// moves data from the per lidar rings to the chunk buffers
+	void ingestThread();
+
+	DumpedChunk dumpChunk() override;
 
 private:
-	bool isDone{false};
+	static constexpr size_t MaxLidars = 8;
+	static constexpr size_t PointsRingCapacity = 1024; // packets, ~0.5 s of MID360 data
+	static constexpr size_t ImuRingCapacity = 256; // samples, ~1 s of MID360 data
+	static constexpr uint32_t FreeSlot = 0; // handle is lidar IP, never 0
+	static constexpr uint16_t UnknownLidarId = 255;
+
+	//! Single writer counter, a relaxed load and store is enough and avoids a locked read-modify-write
+	static void bump(std::atomic<uint64_t>& counter, uint64_t n = 1)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	//! Ingestion statistics of one lidar, each counter has exactly one writer thread
+	struct alignas(64) LidarStats
+	{
+		// written by the point callback
+		std::atomic<uint64_t> pointPackets{0};
+		std::atomic<uint64_t> points{0};
+		std::atomic<uint64_t> bytes{0};
+		std::atomic<uint64_t> zeroRangePoints{0};
+		std::atomic<uint64_t> timestampGaps{0};
+		std::atomic<uint64_t> outOfOrderPackets{0};
+		std::atomic<uint64_t> lostPackets{0};
+		std::atomic<uint64_t> reorderedPackets{0};
+		std::atomic<uint64_t> lostFrames{0};
+		uint64_t lastPacketTimestamp{0}; // point callback private
+		uint64_t packetPeriod{0}; // point callback private, running average of the packet spacing in ns
+		uint16_t lastUdpCnt{0}; // point callback private
+		uint8_t lastFrameCnt{0}; // point callback private
+		bool hasSequence{false}; // point callback private
+
+		// written by the IMU callback
+		alignas(64) std::atomic<uint64_t> imuPackets{0};
+
+		// written by the sampler in the watch thread
+		alignas(64) std::atomic<double> pointPacketsPerSecond{0};
+		std::atomic<double> pointsPerSecond{0};
+		std::atomic<double> imuPacketsPerSecond{0};
+		uint64_t sampledPointPackets{0};
+		uint64_t sampledPoints{0};
+		uint64_t sampledImuPackets{0};
+		std::chrono::steady_clock::time_point sampledAt{};
+	};
+
+	//! State shared between the SDK callbacks (producers) and the ingest thread (consumer) of a single lidar
+	struct LidarSlot
+	{
+		std::atomic<uint32_t> handle{FreeSlot};
+		utils::SpscRing<LivoxPointsPacket> points{PointsRingCapacity};
+		utils::SpscRing<LivoxIMU> imu{ImuRingCapacity};
+		std::atomic<uint64_t> pointsOverruns{0};
+		std::atomic<uint64_t> imuOverruns{0};
+		std::atomic<uint64_t> lastTimestamp{0};
+		utils::ClockModel clock; // updated by the point callback, read by the IMU callback
+		LidarStats stats;
+	};
+
+	std::atomic<bool> isDone{false};
 	std::thread m_livoxWatchThread;
+	std::thread m_ingestThread;
+	std::thread m_spillThread;
+	std::mutex m_ingestMutex; // serializes ring consumers: ingest thread and retrieveData
 	std::mutex m_bufferImuMutex;
 	std::mutex m_bufferLidarMutex;
 
+	//! Slots are claimed in order and never released, lookup is lock-free
+	std::array<LidarSlot, MaxLidars> m_lidarSlots;
+
+	//! Immutable handle to lidar id and slot mapping, rebuilt only when the set of lidars changes
+	struct LidarIdTable
+	{
+		static constexpr size_t Buckets = 2 * MaxLidars; // power of two, open addressing never more than half full
+		struct Entry
+		{
+			uint32_t handle{FreeSlot};
+			uint16_t lidarId{UnknownLidarId};
+			LidarSlot* slot{nullptr};
+		};
+		std::array<Entry, Buckets> entries{};
+
+		static size_t bucket(uint32_t handle)
+		{
+			return (handle * 2654435761u) & (Buckets - 1);
+		}
+		const Entry* find(uint32_t handle) const;
+		void insert(uint32_t handle, uint16_t lidarId, LidarSlot* slot);
+	};
+
+	//! Current table, read by the SDK callbacks without locks
+	std::atomic<const LidarIdTable*> m_lidarIdTable{nullptr};
+	//! Every table ever published, kept alive until destruction so callbacks never read freed memory
+	std::vector<std::unique_ptr<LidarIdTable>> m_lidarIdTables;
+
+	const bool m_deferExpansion;
+	const unsigned m_lazThreads;
+	const LasFormat m_lasFormat;
+	const bool m_binaryImu;
 	LivoxPointsBufferPtr m_bufferLivoxPtr{nullptr};
+	LivoxPacketsBufferPtr m_bufferPacketsPtr{nullptr};
 	LivoxIMUBufferPtr m_bufferIMUPtr{nullptr};
+	size_t m_lastChunkPackets{0}; // used to pre-allocate the packet arena of the next chunk
+
 
-	LivoxPointsBufferPtr dumpedBufferLivoxPtr{nullptr}; // needed by SaveChunkToDirClient
+	//! latest system timestamp of any lidar, lock-free for the packet writer and every reader
+	utils::SensorClock m_clock;
 
-	std::mutex m_timestampMutex;
-	uint64_t m_timestamp{};
+	//! system time the packet being replayed arrived at, set by LivoxReplaySource on its thread, 0 when live
+	uint64_t m_replayArrival{0};
 
 	//! Multilovx support
 	mutable std::mutex m_lidarInfoMutex;
-	std::unordered_map<uint32_t, uint64_t> m_recivedImuMsgs;
-	std::unordered_map<uint32_t, uint64_t> m_recivedPointMessages;
 	std::unordered_map<uint32_t, LivoxLidarInfo> m_LivoxLidarInfo;
 	std::unordered_map<uint32_t, int32_t> m_LivoxLidarWorkMode;
 	std::unordered_map<uint32_t, int32_t> m_LivoxLidarTimeSync;
 
-
-	std::unordered_map<uint32_t, uint64_t> m_handleToLastTimestamp;
 	std::unordered_map<uint32_t, std::string> m_handleToSerialNumber;
 
-	static void setTimestamp(uint64_t ts, LivoxClient* this_ptr);
-
 
 	//! This is a set of serial numbers that we have already seen, its used to find lidarId
 	std::set<std::string> m_serialNumbers;
+	std::unordered_map<std::string, uint16_t> m_serialNumberToLidarId;
+	//! While logging ids are frozen, lidars appearing mid session get the next free id
+	bool m_sessionActive{false};
 
 	bool init_succes{false};
-	uint64_t systemTimestampDelay{};
+
+	//! set before the SDK starts, read by the callbacks without locks
+	std::shared_ptr<LivoxPacketRecorder> m_recorder;
+
+	std::shared_ptr<LazTranscoder> m_transcoder;
+
+	//! starts the watch, ingest and spill threads
+	void startThreads();
+
+	//! registers a lidar reported by the SDK or by a replay
+	void addLidar(uint32_t handle, const LivoxLidarInfo& info);
 
 	//! converts a handle to a lidar id. The logic is as follows:
 	//! id is zero for lidar with smallest Serial number
 	//! @param handle the handle to convert
 	uint16_t handleToLidarId(uint32_t handle) const;
 
-	IterableToFileSaver<std::deque, LivoxIMU> imuIteratorToFileSaver;
-	IterableToFileSaver<std::unordered_map, uint32_t, std::string> lidarIteratorToFileSaver;
-	std::shared_ptr<std::deque<LivoxIMU>> dumpedBufferImuPtr;
+	//! recomputes lidar ids and publishes a new LidarIdTable, m_lidarInfoMutex must be held
+	//! @param keepIds if true lidars that already have an id keep it
+	void rebuildLidarIdTable(bool keepIds);
+
+	//! finds the slot and lidar id of the handle, O(1) and lock-free for known lidars
+	//! @return nullptr when all slots are taken
+	LidarSlot* handleToSlot(uint32_t handle, uint16_t& lidarId);
+
+	//! finds or claims the slot of the handle by scanning the slots, nullptr when all slots are taken
+	LidarSlot* claimSlot(uint32_t handle);
+
+	//! updates packet and point rates of every lidar, called by the watch thread
+	void sampleRates();
+
+	//! updates the point statistics of a lidar, called by the point callback
+	static void updatePointStats(LidarStats& stats, const LivoxLidarEthernetPacket* data, uint64_t timestamp);
+
+	//! detects lost and reordered packets from udp_cnt/frame_cnt, O(1), called by the point callback
+	static void updateSequenceStats(LidarStats& stats, const LivoxLidarEthernetPacket* data, uint64_t timestamp);
+
+	//! offset and drift of the clock of a lidar
+	static nlohmann::json clockModelToJson(const utils::ClockModel& clock);
+	static nlohmann::json pointsStatsToJson(const LivoxPointsStats& stats);
+
+	//! builds per chunk metadata from the counters, differences against the previous chunk
+	nlohmann::json produceChunkMetadata();
+
+	//! counters at the end of the previous chunk, only touched by the state machine thread
+	struct ChunkCounters
+	{
+		uint64_t pointPackets{0};
+		uint64_t lostPackets{0};
+		uint64_t reorderedPackets{0};
+		uint64_t lostFrames{0};
+		uint64_t overruns{0};
+	};
+	std::array<ChunkCounters, MaxLidars> m_lastChunkCounters{};
+
+	//! drains all rings into the chunk buffers, returns number of consumed elements
+	size_t drainRings();
+
+	//! expands a point packet into the buffer, dropping the points rejected by the point filter and the voxel grid
+	void appendPacket(const LivoxPointsPacket& packet, LivoxPointsBuffer& buffer, VoxelDownsampler& voxels);
+
+	const PointFilterConfig m_pointFilter;
+	//! rejection counts of the point filter, raw mode expands chunks on the saving thread so updates are atomic adds
+	struct FilterStats
+	{
+		std::atomic<uint64_t> points{0};
+		std::atomic<uint64_t> range{0};
+		std::atomic<uint64_t> box{0};
+		std::atomic<uint64_t> tag{0};
+		std::atomic<uint64_t> reflectivity{0};
+		std::atomic<uint64_t> rejected{0};
+	};
+	FilterStats m_filterStats;
+
+	const VoxelGridConfig m_voxelGridConfig;
+	//! voxels of the chunk being collected, guarded by m_bufferLidarMutex and cleared at every chunk
+	VoxelDownsampler m_voxelGrid;
+	std::atomic<uint64_t> m_voxelDroppedPoints{0};
+
+	//! Memory budget of the chunk being collected. The current segment is sealed at half the budget,
+	//! so the segment being spilled and the one being filled fit in it together.
+	//! Lock order: m_spillFileMutex, m_bufferLidarMutex, m_sealedMutex
+	const LivoxMemoryBudget m_memoryBudget;
+	std::mutex m_sealedMutex;
+	std::condition_variable m_sealedCondition;
+	std::deque<LivoxSegment> m_sealedSegments; // guarded by m_sealedMutex, the front one is being spilled
+	size_t m_sealedMemory{0}; // guarded by m_sealedMutex
+	std::mutex m_spillFileMutex; // held by the spill thread while it writes
+	std::shared_ptr<ChunkSpillFile> m_spillFile; // guarded by m_spillFileMutex
+	std::atomic<bool> m_spillFailed{false}; // stops spilling until the next chunk
+	size_t m_spillFiles{0};
+	std::atomic<size_t> m_bufferMemory{0}; // memory of the chunk being collected, for status
+
+	//! seals the current segment when the chunk crosses its memory budget, m_bufferLidarMutex must be held
+	void sealSegmentIfOverBudget(size_t imuMemory);
+
+	//! writes sealed segments to the spill file of the current chunk
+	void spillThread();
+
+	//! compresses the chunk being collected in blocks of LazChunkPoints, null unless streaming LAZ
+	std::unique_ptr<LazStream> m_lazStream;
+
+	//! hands the current point buffer to the LAZ stream once it holds a block, m_bufferLidarMutex must be held
+	void streamBlockIfFull();
+
+	//! lidarNNNN.ls line: "lidar_id serial_number"
+	struct LidarListFormatter
+	{
+		size_t maxLength(const std::pair<const uint32_t, std::string>& idSn) const
+		{
+			return 11 + idSn.second.size();
+		}
+		char* operator()(const std::pair<const uint32_t, std::string>& idSn, char* out) const;
+	};
+
+	//! a chunk handed over by dumpChunk, owned by its save job
+	struct DumpedLivoxChunk
+	{
+		LivoxChunk data;
+		std::unordered_map<uint32_t, std::string> lidars;
+		nlohmann::json metadata;
+	};
+
+	//! writes imu, lidar list, points and metadata of a dumped chunk; the chunk parts are stitched back together here
+	//! false when the chunk could not be saved completely
+	bool saveDumpedChunk(DumpedLivoxChunk& dumped, const std::filesystem::path& directory, int chunk);
 
 
 	static constexpr char config[] =
@@ -0,0 +1,53 @@
+#ifndef MANDEYE_MULTISENSOR_LIVOXREPLAYSOURCE_H
+#define MANDEYE_MULTISENSOR_LIVOXREPLAYSOURCE_H
+
+#include "clients/JsonStateProducer.h"
+#include "utils/livox_recording.h"
+#include <atomic>
+#include <json.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace mandeye
+{
+class LivoxClient;
+
+//! Feeds a recording made by LivoxPacketRecorder through the LivoxClient SDK callbacks,
+//! so the whole pipeline runs without a lidar.
+class LivoxReplaySource : public JsonStateProducer
+{
+public:
+	//! @param speed 1 replays in real time, N is N times faster, 0 is as fast as possible
+	//! @param loop starts again from the beginning at the end of the recording
+	LivoxReplaySource(std::shared_ptr<LivoxClient> client, const std::string& path, double speed, bool loop);
+	~LivoxReplaySource();
+
+	//! starts the client without LivoxSDK2 and the replay thread
+	bool start();
+	void stop();
+
+	nlohmann::json produceStatus() override;
+	std::string getJsonName() override;
+
+private:
+	void replayThread();
+
+	std::shared_ptr<LivoxClient> m_client;
+	LivoxRecordingReader m_reader;
+	const std::string m_path;
+	const double m_speed;
+	const bool m_loop;
+	std::atomic<bool> m_done{false};
+	std::atomic<bool> m_finished{false};
+	std::atomic<uint64_t> m_packets{0};
+	std::atomic<uint64_t> m_points{0};
+	std::atomic<uint64_t> m_loops{0};
+	std::atomic<uint64_t> m_lagNs{0}; // how late the last packet was delivered, real time replay only
+	std::atomic<double> m_pointsPerSecond{0};
+	std::thread m_thread;
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_LIVOXREPLAYSOURCE_H
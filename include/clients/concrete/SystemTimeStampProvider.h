@@ -11,7 +11,7 @@ class SystemTimeStampProvider: public TimeStampProvider
 {
 
 public:
-	uint64_t getTimestamp() override;
+	uint64_t getTimestamp() noexcept override;
 };
 
 } // namespace mandeye
@@ -1,23 +1,58 @@
 #ifndef MANDEYE_MULTISENSOR_LIVOX_TYPES_H
 #define MANDEYE_MULTISENSOR_LIVOX_TYPES_H
 
+#include "utils/BlockArena.h"
 #include <livox_lidar_def.h>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <unordered_map>
 #include <memory>
 #include <deque>
 #include <string>
 #include <set>
 #include <thread>
+#include <vector>
 
 namespace mandeye
 {
 
-struct LivoxPoint
+//! Maximum number of points in a single Livox UDP point packet (MID360 sends 96)
+constexpr uint16_t LivoxMaxPointsPerPacket = 96;
+
+//! time_interval of a packet is the time span of the whole packet, in 0.1 us
+constexpr uint64_t LivoxTimeIntervalUnitNs = 100;
+
+//! ns from the packet timestamp to point index of a packet with points spread evenly over its time_interval
+constexpr uint32_t livoxPointTimeOffset(uint16_t timeInterval, uint32_t index, uint32_t points)
 {
-	LivoxLidarCartesianHighRawPoint point;
-	uint64_t timestamp;
-	uint8_t line_id;
+	return points == 0 ? 0 : static_cast<uint32_t>(index * timeInterval * LivoxTimeIntervalUnitNs / points);
+}
+// the last point of a full packet ends inside the packet span, so packets do not overlap in time
+static_assert(livoxPointTimeOffset(UINT16_MAX, LivoxMaxPointsPerPacket - 1, LivoxMaxPointsPerPacket) < UINT16_MAX * LivoxTimeIntervalUnitNs);
+// a MID360 packet of 96 points at 200 kpts/s spans 480 us, points are 5 us apart
+static_assert(livoxPointTimeOffset(4800, 1, LivoxMaxPointsPerPacket) == 5000);
+static_assert(livoxPointTimeOffset(4800, LivoxMaxPointsPerPacket - 1, LivoxMaxPointsPerPacket) == 475000);
+
+//! MID360 points of a packet cycle through its 4 scan lines
+constexpr uint8_t LivoxMid360Lines = 4;
+
+//! return number of a point, 0 for the first return, bits 4-5 of the Livox tag
+inline uint8_t livoxReturnIndex(uint8_t tag)
+{
+	return (tag >> 4) & 0x3;
+}
+
+//! Point packet copied out of the SDK callback, decoded into LivoxPointsBuffer by the ingest thread.
+//! Payload holds the points as sent by the lidar, any of the cartesian high/low or spherical formats.
+struct LivoxPointsPacket
+{
+	uint64_t timestamp; // sensor timestamp of the first point, already shifted to system time
 	uint16_t laser_id;
+	uint16_t time_interval;
+	uint16_t dot_num;
+	uint8_t data_type;
+	uint8_t payload[LivoxMaxPointsPerPacket * sizeof(LivoxLidarCartesianHighRawPoint)];
 };
 
 struct LivoxIMU
@@ -39,14 +74,212 @@ const std::unordered_map<int32_t, std::string> WorkModeToStr{
 	{-1, "FailedToGetWorkMode"},
 };
 
-using LivoxPointsBuffer = std::deque<LivoxPoint>;
-using LivoxPointsBufferPtr = std::shared_ptr<std::deque<LivoxPoint>>;
-using LivoxPointsBufferConstPtr = std::shared_ptr<const std::deque<LivoxPoint>>;
+//! Summary of the points of a buffer, kept up to date as points are pushed so writers and metadata need no extra pass
+struct LivoxPointsStats
+{
+	static constexpr size_t Returns = 4; // livoxReturnIndex
+
+	uint64_t points{0};
+	int32_t minX{std::numeric_limits<int32_t>::max()}; // mm
+	int32_t minY{std::numeric_limits<int32_t>::max()};
+	int32_t minZ{std::numeric_limits<int32_t>::max()};
+	int32_t maxX{std::numeric_limits<int32_t>::lowest()};
+	int32_t maxY{std::numeric_limits<int32_t>::lowest()};
+	int32_t maxZ{std::numeric_limits<int32_t>::lowest()};
+	uint64_t firstTimestamp{std::numeric_limits<uint64_t>::max()}; // ns
+	uint64_t lastTimestamp{0};
+	std::array<uint64_t, 256> pointsPerLidar{}; // by laser_id
+	std::array<uint64_t, Returns> pointsPerReturn{};
+	std::array<uint64_t, 256> reflectivity{}; // histogram
+
+	void add(int32_t x, int32_t y, int32_t z, uint8_t preflectivity, uint8_t tag, uint8_t laser_id, uint64_t timestamp)
+	{
+		points++;
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		minZ = std::min(minZ, z);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		maxZ = std::max(maxZ, z);
+		firstTimestamp = std::min(firstTimestamp, timestamp);
+		lastTimestamp = std::max(lastTimestamp, timestamp);
+		pointsPerLidar[laser_id]++;
+		pointsPerReturn[livoxReturnIndex(tag)]++;
+		reflectivity[preflectivity]++;
+	}
+
+	void merge(const LivoxPointsStats& other)
+	{
+		if(other.points == 0)
+		{
+			return;
+		}
+		points += other.points;
+		minX = std::min(minX, other.minX);
+		minY = std::min(minY, other.minY);
+		minZ = std::min(minZ, other.minZ);
+		maxX = std::max(maxX, other.maxX);
+		maxY = std::max(maxY, other.maxY);
+		maxZ = std::max(maxZ, other.maxZ);
+		firstTimestamp = std::min(firstTimestamp, other.firstTimestamp);
+		lastTimestamp = std::max(lastTimestamp, other.lastTimestamp);
+		for(size_t i = 0; i < pointsPerLidar.size(); i++)
+		{
+			pointsPerLidar[i] += other.pointsPerLidar[i];
+			reflectivity[i] += other.reflectivity[i];
+		}
+		for(size_t i = 0; i < Returns; i++)
+		{
+			pointsPerReturn[i] += other.pointsPerReturn[i];
+		}
+	}
+};
+
+//! Columnar (structure of arrays) point storage of a chunk, ~20 bytes per point.
+//! Points are grouped by packet, the timestamp of a point is the base timestamp of its packet plus its own offset.
+class LivoxPointsBuffer
+{
+public:
+	std::vector<int32_t> x; // mm
+	std::vector<int32_t> y;
+	std::vector<int32_t> z;
+	std::vector<uint8_t> reflectivity;
+	std::vector<uint8_t> tag;
+	std::vector<uint8_t> line_id;
+	std::vector<uint8_t> laser_id;
+	std::vector<uint32_t> timestampOffset; // ns from the packet base timestamp
+
+	std::vector<uint64_t> packetTimestamp; // ns, base timestamp of each packet
+	std::vector<uint32_t> packetFirstPoint; // index of the first point of each packet
+
+	//! of all points, maintained by push and append. Code filling the columns directly merges the stats of what it adds.
+	LivoxPointsStats stats;
+
+	size_t size() const
+	{
+		return x.size();
+	}
+
+	bool empty() const
+	{
+		return x.empty();
+	}
+
+	size_t packets() const
+	{
+		return packetTimestamp.size();
+	}
+
+	void reserve(size_t points, size_t packets)
+	{
+		x.reserve(points);
+		y.reserve(points);
+		z.reserve(points);
+		reflectivity.reserve(points);
+		tag.reserve(points);
+		line_id.reserve(points);
+		laser_id.reserve(points);
+		timestampOffset.reserve(points);
+		packetTimestamp.reserve(packets);
+		packetFirstPoint.reserve(packets);
+	}
+
+	//! Starts a new packet, points pushed afterwards belong to it
+	void beginPacket(uint64_t timestamp)
+	{
+		packetTimestamp.push_back(timestamp);
+		packetFirstPoint.push_back(static_cast<uint32_t>(x.size()));
+	}
+
+	void push(int32_t px, int32_t py, int32_t pz, uint8_t preflectivity, uint8_t ptag, uint8_t pline_id, uint8_t plaser_id, uint32_t offset)
+	{
+		x.push_back(px);
+		y.push_back(py);
+		z.push_back(pz);
+		reflectivity.push_back(preflectivity);
+		tag.push_back(ptag);
+		line_id.push_back(pline_id);
+		laser_id.push_back(plaser_id);
+		timestampOffset.push_back(offset);
+		stats.add(px, py, pz, preflectivity, ptag, plaser_id, packetTimestamp.back() + offset);
+	}
+
+	//! Calls f(packetTimestamp, firstPoint, endPoint) for every packet in order
+	template <typename F>
+	void forEachPacket(F&& f) const
+	{
+		for(size_t p = 0; p < packetTimestamp.size(); p++)
+		{
+			const size_t end = p + 1 < packetFirstPoint.size() ? packetFirstPoint[p + 1] : x.size();
+			f(packetTimestamp[p], static_cast<size_t>(packetFirstPoint[p]), end);
+		}
+	}
+
+	//! Appends all points and packets of another buffer
+	void append(const LivoxPointsBuffer& other)
+	{
+		const uint32_t base = static_cast<uint32_t>(x.size());
+		x.insert(x.end(), other.x.begin(), other.x.end());
+		y.insert(y.end(), other.y.begin(), other.y.end());
+		z.insert(z.end(), other.z.begin(), other.z.end());
+		reflectivity.insert(reflectivity.end(), other.reflectivity.begin(), other.reflectivity.end());
+		tag.insert(tag.end(), other.tag.begin(), other.tag.end());
+		line_id.insert(line_id.end(), other.line_id.begin(), other.line_id.end());
+		laser_id.insert(laser_id.end(), other.laser_id.begin(), other.laser_id.end());
+		timestampOffset.insert(timestampOffset.end(), other.timestampOffset.begin(), other.timestampOffset.end());
+		packetTimestamp.insert(packetTimestamp.end(), other.packetTimestamp.begin(), other.packetTimestamp.end());
+		for(const uint32_t first : other.packetFirstPoint)
+		{
+			packetFirstPoint.push_back(base + first);
+		}
+		stats.merge(other.stats);
+	}
+
+	//! Bytes held by the columns
+	size_t memoryUsage() const
+	{
+		return x.capacity() * sizeof(int32_t) * 3 + reflectivity.capacity() * 4 + timestampOffset.capacity() * sizeof(uint32_t) +
+			   packetTimestamp.capacity() * sizeof(uint64_t) + packetFirstPoint.capacity() * sizeof(uint32_t);
+	}
+};
+
+using LivoxPointsBufferPtr = std::shared_ptr<LivoxPointsBuffer>;
+using LivoxPointsBufferConstPtr = std::shared_ptr<const LivoxPointsBuffer>;
 using LivoxIMUBuffer = std::deque<LivoxIMU>;
 using LivoxIMUBufferPtr = std::shared_ptr<std::deque<LivoxIMU>>;
 using LivoxIMUBufferConstPtr = std::shared_ptr<const std::deque<LivoxIMU>>;
+using LivoxPacketsBuffer = utils::BlockArena<LivoxPointsPacket>;
+using LivoxPacketsBufferPtr = std::shared_ptr<LivoxPacketsBuffer>;
 using ThreadMap = std::unordered_map<std::string,std::shared_ptr<std::thread>>;
 
+//! Part of a chunk sealed when the chunk crossed its memory budget, only one of the buffers is set
+struct LivoxSegment
+{
+	LivoxPointsBufferPtr points;
+	LivoxPacketsBufferPtr packets;
+
+	size_t memoryUsage() const
+	{
+		return points ? points->memoryUsage() : packets ? packets->memoryUsage() : 0;
+	}
+};
+
+class ChunkSpillFile;
+class LazStreamFile;
+
+//! Everything the lidars delivered during one chunk
+struct LivoxChunk
+{
+	LivoxPointsBufferPtr points;
+	LivoxPacketsBufferPtr packets; // filled instead of points with deferred expansion, expanded when the chunk is saved
+	LivoxIMUBufferPtr imu;
+	//! earlier parts of the chunk in capture order: first the spilled segments, then the sealed ones still in memory
+	std::shared_ptr<ChunkSpillFile> spill;
+	std::vector<LivoxSegment> sealed;
+	//! streaming LAZ mode: the file the points of the chunk were compressed to, points and segments stay empty
+	std::shared_ptr<LazStreamFile> stream;
+};
+
 } // namespace mandeye
 
 #endif //MANDEYE_MULTISENSOR_LIVOX_TYPES_H
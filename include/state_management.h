@@ -2,6 +2,7 @@
 #define MANDEYE_MULTISENSOR_STATE_MANAGEMENT_H
 
 #include "clients/concrete/CamerasClient.h"
+#include "clients/concrete/ChunkWriter.h"
 #include "clients/concrete/FileSystemClient.h"
 #include "clients/concrete/GnssClient.h"
 #include "clients/concrete/GpioClient.h"
@@ -47,6 +48,7 @@ extern std::atomic<bool> isRunning;
 extern std::shared_ptr<TimeStampProvider> timeStampProviderPtr;
 extern std::shared_ptr<GpioClient> gpioClientPtr;
 extern std::shared_ptr<FileSystemClient> fileSystemClientPtr;
+extern std::shared_ptr<ChunkWriter> chunkWriterPtr;
 extern std::vector<std::shared_ptr<SaveChunkToDirClient>> saveableClients;
 extern std::vector<std::shared_ptr<LoggerClient>> loggerClients;
 extern std::vector<std::shared_ptr<JsonStateProducer>> jsonReportProducerClients;
@@ -60,7 +62,7 @@ bool StopScan();
 
 bool TriggerStopScan();
 bool TriggerContinousScanning();
-bool saveChunkToDisk(const std::string& outDirectory, int chunk);
+bool saveChunkToDisk(const std::string& outDirectory, int chunk, bool stopScan);
 
 void stateWatcher();
 } // namespace mandeye
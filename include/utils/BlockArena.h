@@ -0,0 +1,67 @@
+#ifndef MANDEYE_MULTISENSOR_BLOCKARENA_H
+#define MANDEYE_MULTISENSOR_BLOCKARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace utils
+{
+
+//! Append-only storage made of fixed size blocks.
+//! Elements never move once appended and `reserve` allocates the blocks up front,
+//! so appending to a reserved arena is a plain copy with no allocation.
+template <typename T, size_t BlockSize = 256>
+class BlockArena
+{
+private:
+	std::vector<std::unique_ptr<T[]>> blocks;
+	size_t count = 0;
+
+public:
+	void reserve(size_t n) {
+		while (blocks.size() * BlockSize < n)
+			blocks.emplace_back(new T[BlockSize]);
+	}
+
+	//! Returns the next free element, its content is whatever the caller writes into it
+	T& append() {
+		if (count == blocks.size() * BlockSize)
+			blocks.emplace_back(new T[BlockSize]);
+		T& elem = blocks[count / BlockSize][count % BlockSize];
+		count++;
+		return elem;
+	}
+
+	const T& operator[](size_t i) const {
+		return blocks[i / BlockSize][i % BlockSize];
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	//! Bytes held by the allocated blocks
+	size_t memoryUsage() const {
+		return blocks.size() * BlockSize * sizeof(T);
+	}
+
+	//! Calls `f` for every element in insertion order
+	template <typename F>
+	void forEach(F&& f) const {
+		for (size_t b = 0; b * BlockSize < count; b++) {
+			const size_t n = std::min(BlockSize, count - b * BlockSize);
+			for (size_t i = 0; i < n; i++)
+				f(blocks[b][i]);
+		}
+	}
+};
+
+} // namespace utils
+
+#endif //MANDEYE_MULTISENSOR_BLOCKARENA_H
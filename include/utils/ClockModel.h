@@ -0,0 +1,185 @@
+#ifndef MANDEYE_MULTISENSOR_CLOCKMODEL_H
+#define MANDEYE_MULTISENSOR_CLOCKMODEL_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace utils
+{
+
+//! Maps the timestamps of one sensor to system time: system = sensor + offset + drift * (sensor - reference).
+//! Network and scheduling delays only ever make a packet late, so the smallest arrival - sensor difference of a
+//! window is the best offset sample of that window. A line fitted through the window minima, with exponential
+//! forgetting, gives offset and drift. A packet far below the line or sensor time going back is a clock step (reboot,
+//! time sync starting) and restarts the model. A window minimum far above the line is left out of the fit, as a burst of
+//! congestion can delay a whole window; StepWindows of them in a row are a clock step too.
+//! One writer thread feeds arrivals, any number of threads convert; parameters are published under a seqlock.
+class ClockModel
+{
+public:
+	static constexpr uint64_t WindowNs = 1'000'000'000;
+	static constexpr int64_t StepNs = 50'000'000; // bigger residuals are a clock step, not jitter
+	static constexpr double Forgetting = 0.99; // per window, ~100 s memory
+	static constexpr int StepWindows = 3; // consecutive late windows taken as a clock step
+
+	struct Parameters
+	{
+		int64_t offset{0}; // ns, at reference
+		double drift{0}; // ns per sensor ns
+		uint64_t reference{0}; // sensor ns, 0 before the first update
+	};
+
+	//! Feeds a packet and converts its timestamp, writer only
+	//! @param arrival system time the packet was received at, in ns
+	uint64_t update(uint64_t sensorTimestamp, uint64_t arrival) noexcept
+	{
+		const int64_t delay = static_cast<int64_t>(arrival - sensorTimestamp);
+		if(m_model.reference == 0)
+		{
+			restart(sensorTimestamp, delay);
+		}
+		else if(sensorTimestamp + StepNs < m_windowStart || delay + StepNs < predictedDelay(sensorTimestamp))
+		{
+			// sensor time went back, or a packet arrived before it was sent: the sensor clock was set
+			m_steps.fetch_add(1, std::memory_order_relaxed);
+			restart(sensorTimestamp, delay);
+		}
+		else if(sensorTimestamp >= m_windowStart + WindowNs)
+		{
+			closeWindow();
+			m_windowStart = sensorTimestamp;
+			m_windowMinimum = delay;
+			m_windowSensor = sensorTimestamp;
+		}
+		else if(delay < m_windowMinimum)
+		{
+			m_windowMinimum = delay;
+			m_windowSensor = sensorTimestamp;
+		}
+		return convert(m_model, sensorTimestamp);
+	}
+
+	//! Converts a sensor timestamp to system time, 0 before the first update
+	uint64_t toSystem(uint64_t sensorTimestamp) const noexcept
+	{
+		const Parameters model = parameters();
+		return model.reference == 0 ? 0 : convert(model, sensorTimestamp);
+	}
+
+	Parameters parameters() const noexcept
+	{
+		Parameters model;
+		uint32_t before;
+		uint32_t after;
+		do
+		{
+			before = m_sequence.load(std::memory_order_acquire);
+			model.offset = m_offset.load(std::memory_order_relaxed);
+			model.drift = m_drift.load(std::memory_order_relaxed);
+			model.reference = m_reference.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = m_sequence.load(std::memory_order_relaxed);
+		} while((before & 1) != 0 || before != after);
+		return model;
+	}
+
+	uint64_t windows() const noexcept
+	{
+		return m_windows.load(std::memory_order_relaxed);
+	}
+
+	uint64_t steps() const noexcept
+	{
+		return m_steps.load(std::memory_order_relaxed);
+	}
+
+private:
+	static uint64_t convert(const Parameters& model, uint64_t sensorTimestamp) noexcept
+	{
+		const double elapsed = static_cast<double>(static_cast<int64_t>(sensorTimestamp - model.reference));
+		return sensorTimestamp + model.offset + static_cast<int64_t>(model.drift * elapsed);
+	}
+
+	int64_t predictedDelay(uint64_t sensorTimestamp) const noexcept
+	{
+		return static_cast<int64_t>(convert(m_model, sensorTimestamp) - sensorTimestamp);
+	}
+
+	void restart(uint64_t sensorTimestamp, int64_t delay) noexcept
+	{
+		m_origin = sensorTimestamp;
+		m_originDelay = delay;
+		m_s0 = m_sx = m_sy = m_sxx = m_sxy = 0;
+		m_lateWindows = 0;
+		m_windowStart = sensorTimestamp;
+		m_windowMinimum = delay;
+		m_windowSensor = sensorTimestamp;
+		publish({delay, 0.0, sensorTimestamp});
+	}
+
+	void closeWindow() noexcept
+	{
+		if(m_s0 > 0 && m_windowMinimum - predictedDelay(m_windowSensor) > StepNs)
+		{
+			if(++m_lateWindows >= StepWindows)
+			{
+				m_steps.fetch_add(1, std::memory_order_relaxed);
+				restart(m_windowSensor, m_windowMinimum);
+			}
+			return;
+		}
+		m_lateWindows = 0;
+		// seconds and ns relative to the origin keep the sums well conditioned
+		const double x = static_cast<int64_t>(m_windowSensor - m_origin) * 1e-9;
+		const double y = static_cast<double>(m_windowMinimum - m_originDelay);
+		m_s0 = m_s0 * Forgetting + 1;
+		m_sx = m_sx * Forgetting + x;
+		m_sy = m_sy * Forgetting + y;
+		m_sxx = m_sxx * Forgetting + x * x;
+		m_sxy = m_sxy * Forgetting + x * y;
+		m_windows.fetch_add(1, std::memory_order_relaxed);
+
+		const double determinant = m_s0 * m_sxx - m_sx * m_sx;
+		double slope = 0; // ns per s
+		if(m_windows.load(std::memory_order_relaxed) > 1 && determinant > 1e-9)
+		{
+			slope = (m_s0 * m_sxy - m_sx * m_sy) / determinant;
+		}
+		const double intercept = (m_sy - slope * m_sx) / m_s0;
+		publish({m_originDelay + static_cast<int64_t>(intercept + slope * x), slope * 1e-9, m_windowSensor});
+	}
+
+	void publish(const Parameters& model) noexcept
+	{
+		m_model = model;
+		const uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_offset.store(model.offset, std::memory_order_relaxed);
+		m_drift.store(model.drift, std::memory_order_relaxed);
+		m_reference.store(model.reference, std::memory_order_relaxed);
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// published
+	std::atomic<uint32_t> m_sequence{0};
+	std::atomic<int64_t> m_offset{0};
+	std::atomic<double> m_drift{0};
+	std::atomic<uint64_t> m_reference{0};
+	std::atomic<uint64_t> m_windows{0};
+	std::atomic<uint64_t> m_steps{0};
+
+	// writer private
+	Parameters m_model;
+	uint64_t m_origin{0};
+	int64_t m_originDelay{0};
+	uint64_t m_windowStart{0};
+	int64_t m_windowMinimum{0};
+	uint64_t m_windowSensor{0};
+	int m_lateWindows{0};
+	double m_s0{0}, m_sx{0}, m_sy{0}, m_sxx{0}, m_sxy{0};
+};
+
+} // namespace utils
+
+#endif //MANDEYE_MULTISENSOR_CLOCKMODEL_H
@@ -0,0 +1,38 @@
+#ifndef MANDEYE_MULTISENSOR_SENSORCLOCK_H
+#define MANDEYE_MULTISENSOR_SENSORCLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace utils
+{
+
+//! Keeps the latest sensor timestamp, converted to system time by the caller.
+//! The value is a single 64-bit atomic, so readers never wait for the writer and never see a torn value.
+class SensorClock
+{
+public:
+	static constexpr uint64_t Unset = std::numeric_limits<uint64_t>::max();
+
+	//! Publishes a system time timestamp as the latest timestamp
+	void publish(uint64_t timestamp) noexcept
+	{
+		latest.store(timestamp, std::memory_order_release);
+	}
+
+	//! Latest published timestamp, Unset before the first `publish`
+	uint64_t now() const noexcept
+	{
+		return latest.load(std::memory_order_acquire);
+	}
+
+private:
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "SensorClock needs lock-free 64-bit atomics");
+
+	std::atomic<uint64_t> latest{Unset};
+};
+
+} // namespace utils
+
+#endif //MANDEYE_MULTISENSOR_SENSORCLOCK_H
@@ -0,0 +1,95 @@
+#ifndef MANDEYE_MULTISENSOR_SPSCRING_H
+#define MANDEYE_MULTISENSOR_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace utils
+{
+
+//! Bounded lock-free single-producer/single-consumer ring.
+//! The producer never blocks: when the ring is full `claim` returns nullptr and the caller drops the element.
+//! Storage is allocated once in the constructor and default-initialized, so pages of an unused ring are never touched.
+template <typename T>
+class SpscRing
+{
+private:
+	static constexpr size_t CacheLine = 64;
+
+	const size_t mask;
+	std::unique_ptr<T[]> storage;
+
+	alignas(CacheLine) std::atomic<size_t> head{0}; // written by producer
+	size_t cachedTail{0}; // producer's view of tail
+
+	alignas(CacheLine) std::atomic<size_t> tail{0}; // written by consumer
+	size_t cachedHead{0}; // consumer's view of head
+
+	static size_t roundUpToPowerOfTwo(size_t n) {
+		size_t p = 1;
+		while (p < n)
+			p <<= 1;
+		return p;
+	}
+
+public:
+	explicit SpscRing(size_t minCapacity)
+		: mask(roundUpToPowerOfTwo(minCapacity) - 1), storage(new T[mask + 1]) {}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	//! Producer side: returns the slot to fill in place, or nullptr when the ring is full.
+	//! Must be followed by `publish` before the next `claim`.
+	T* claim() {
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h - cachedTail > mask) {
+			cachedTail = tail.load(std::memory_order_acquire);
+			if (h - cachedTail > mask)
+				return nullptr;
+		}
+		return &storage[h & mask];
+	}
+
+	//! Producer side: makes the slot returned by `claim` visible to the consumer
+	void publish() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//! Producer side: copies value into the ring, false when full
+	bool push(const T& value) {
+		T* slot = claim();
+		if (slot == nullptr)
+			return false;
+		*slot = value;
+		publish();
+		return true;
+	}
+
+	//! Consumer side: calls `consumer` for every element available now, returns how many were consumed
+	template <typename F>
+	size_t consumeAll(F&& consumer) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		cachedHead = head.load(std::memory_order_acquire);
+		const size_t count = cachedHead - t;
+		for (; t != cachedHead; t++)
+			consumer(storage[t & mask]);
+		tail.store(t, std::memory_order_release);
+		return count;
+	}
+
+	//! Approximate number of queued elements, safe to call from any thread
+	size_t size() const {
+		const size_t t = tail.load(std::memory_order_acquire);
+		return head.load(std::memory_order_acquire) - t;
+	}
+
+	size_t capacity() const {
+		return mask + 1;
+	}
+};
+
+} // namespace utils
+
+#endif //MANDEYE_MULTISENSOR_SPSCRING_H
@@ -0,0 +1,50 @@
+#ifndef MANDEYE_MULTISENSOR_CHUNK_JOURNAL_H
+#define MANDEYE_MULTISENSOR_CHUNK_JOURNAL_H
+
+#include <filesystem>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Journal of the chunks of a session, one line per step, appended and synced:
+//!   begin NNNN                        - the chunk is being written to its staging directory
+//!   synced NNNN name size name size   - the staged files are on disk, directories are listed as "name/ 0"
+//!   commit NNNN                       - the files were moved into the session directory
+//!   quarantined NNNN                  - the chunk failed to save, or was found damaged at startup
+constexpr const char* ChunkJournalName = "chunks.journal";
+//! partial chunks are moved to <session>/quarantine/chunkNNNN
+constexpr const char* QuarantineDirectoryName = "quarantine";
+
+//! fsync of a file or a directory
+bool fsyncPath(const std::filesystem::path& path);
+
+//! hidden directory the chunk is written to before its commit: <session>/.chunkNNNN.part
+std::filesystem::path chunkStagingDirectory(const std::filesystem::path& session, int chunk);
+
+//! creates the staging directory and journals the begin of the chunk
+bool beginChunk(const std::filesystem::path& session, int chunk);
+
+//! Call once the staged files are synced: journals them, moves them into the session directory,
+//! syncs it and journals the commit. `committed` gets the committed paths.
+//! Returns false, and moves nothing, when the synced line could not be journaled.
+bool commitChunk(const std::filesystem::path& session, int chunk, std::vector<std::filesystem::path>& committed);
+
+//! moves the staged files of a chunk that failed to save or sync into the quarantine and journals it
+void quarantineChunk(const std::filesystem::path& session, int chunk);
+
+struct ChunkRecovery
+{
+	size_t sessions{0}; // with a journal
+	size_t finished{0}; // synced but not committed, committed now
+	size_t quarantined{0};
+};
+
+//! Run at startup, before anything writes to the repository. Reads the journal of every session:
+//! a chunk synced but not committed is committed, one not synced is quarantined.
+//! Only the files of the last commit of a session are checked, by size, the earlier ones were synced before it began.
+ChunkRecovery recoverChunks(const std::filesystem::path& repository);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_CHUNK_JOURNAL_H
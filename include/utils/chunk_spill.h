@@ -0,0 +1,76 @@
+#ifndef MANDEYE_MULTISENSOR_CHUNK_SPILL_H
+#define MANDEYE_MULTISENSOR_CHUNK_SPILL_H
+
+#include "livox_types.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+namespace mandeye
+{
+
+//! Memory budget of the Livox chunk buffers, 0 bytes means unlimited
+struct LivoxMemoryBudget
+{
+	size_t bytes{0};
+	//! where sealed segments are spilled, normally the target media
+	std::filesystem::path spillDirectory;
+};
+
+//! Temporary file holding the sealed segments of one chunk in a compact binary form.
+//! Point segments are stored column by column, packet segments without the unused payload.
+//! The file is removed when the object is destroyed.
+class ChunkSpillFile
+{
+public:
+	explicit ChunkSpillFile(std::filesystem::path path);
+	~ChunkSpillFile();
+
+	ChunkSpillFile(const ChunkSpillFile&) = delete;
+	ChunkSpillFile& operator=(const ChunkSpillFile&) = delete;
+
+	//! Appends a segment, on failure the segment is not part of the file
+	bool write(const LivoxPointsBuffer& points);
+	bool write(const LivoxPacketsBuffer& packets);
+
+	//! Reads all segments back in order, point segments are appended to `points`, packets are passed to `onPacket`
+	bool read(LivoxPointsBuffer& points, const std::function<void(const LivoxPointsPacket&)>& onPacket);
+
+	size_t segments() const
+	{
+		return m_segments;
+	}
+	size_t bytes() const
+	{
+		return m_bytes;
+	}
+	//! points and packets written so far, used to reserve the stitched buffer
+	size_t points() const
+	{
+		return m_points;
+	}
+	size_t packets() const
+	{
+		return m_packets;
+	}
+	//! of the point segments, merged into the buffer they are read back to
+	const LivoxPointsStats& pointsStats() const
+	{
+		return m_pointsStats;
+	}
+
+private:
+	bool finishSegment(std::streamoff start);
+
+	std::filesystem::path m_path;
+	std::ofstream m_out;
+	size_t m_segments{0};
+	size_t m_bytes{0};
+	size_t m_points{0};
+	size_t m_packets{0};
+	LivoxPointsStats m_pointsStats;
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_CHUNK_SPILL_H
@@ -0,0 +1,52 @@
+#ifndef MANDEYE_MULTISENSOR_COPC_OCTREE_H
+#define MANDEYE_MULTISENSOR_COPC_OCTREE_H
+
+#include "livox_types.h"
+#include <cstdint>
+#include <vector>
+
+namespace mandeye
+{
+
+//! cells per side of the sampling grid of a node, the root spacing is the cube side divided by it
+constexpr uint32_t CopcGridCells = 128;
+//! nodes with fewer points are leaves, also the largest LAZ chunk of a COPC file but at the deepest level
+constexpr size_t CopcLeafPoints = 50000;
+constexpr int32_t CopcMaxDepth = 16;
+
+//! COPC VoxelKey: depth and position of a node among the 2^depth nodes per side
+struct CopcKey
+{
+	int32_t d, x, y, z;
+
+	CopcKey child(int octant) const
+	{
+		return {d + 1, 2 * x + (octant & 1), 2 * y + ((octant >> 1) & 1), 2 * z + ((octant >> 2) & 1)};
+	}
+};
+
+struct CopcNode
+{
+	CopcKey key;
+	std::vector<uint32_t> points; // indices into the buffer, ascending
+};
+
+//! Every point is in exactly one node. A node keeps one point per cell of its CopcGridCells^3 grid and passes
+//! the others to its children, so the upper levels are an even subsample of the cloud.
+struct CopcOctree
+{
+	double center[3]; // m
+	double halfSize; // m
+	double spacing; // m, between the points of the root
+	std::vector<CopcNode> nodes; // parents before their children
+};
+
+//! Buckets the points level by level, nodes are split on `threads` threads
+CopcOctree buildCopcOctree(const LivoxPointsBuffer& buffer, unsigned threads);
+
+//! Copies the points of a node into a buffer of their own, keeping the packet timestamps
+LivoxPointsBufferPtr gatherCopcNode(const LivoxPointsBuffer& buffer, const CopcNode& node);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_COPC_OCTREE_H
@@ -0,0 +1,42 @@
+#ifndef MANDEYE_MULTISENSOR_IMU_LOG_H
+#define MANDEYE_MULTISENSOR_IMU_LOG_H
+
+#include "livox_types.h"
+#include <string>
+
+namespace mandeye
+{
+
+//! Extension of binary IMU chunks, next to the csv ones: imuNNNN.mdimu
+constexpr const char* ImuBinaryExtension = "mdimu";
+
+//! longest line of formatImuCsv, without the newline
+constexpr size_t ImuCsvMaxLine = 128;
+
+//! Writes "timestamp gyro_x gyro_y gyro_z acc_x acc_y acc_z laser_id" at `out`, the text the stringstream formatter wrote
+//! (floats with 6 significant digits). Returns the end of the line, no newline is written.
+char* formatImuCsv(const LivoxIMU& imu, char* out);
+
+//! IterableToFileSaver formatter of imuNNNN.csv
+struct ImuCsvFormatter
+{
+	size_t maxLength(const LivoxIMU&) const
+	{
+		return ImuCsvMaxLine;
+	}
+	char* operator()(const LivoxIMU& imu, char* out) const
+	{
+		return formatImuCsv(imu, out);
+	}
+};
+
+//! Binary IMU chunk: a 24 byte header ("MDIMU\0\0\0", version, record size, record count)
+//! followed by packed little endian records of 36 bytes: uint64 timestamp, 3 float gyro, 3 float acc, uint16 laser_id, 2 reserved
+bool saveImuBinary(const std::string& filename, const LivoxIMUBuffer& imu);
+
+//! Appends the records of a saveImuBinary file to `imu`
+bool loadImuBinary(const std::string& filename, LivoxIMUBuffer& imu);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_IMU_LOG_H
@@ -0,0 +1,18 @@
+#ifndef MANDEYE_MULTISENSOR_LAZ_CHUNK_TABLE_H
+#define MANDEYE_MULTISENSOR_LAZ_CHUNK_TABLE_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Writes the LASzip chunk table, as LASwritePoint does when it closes.
+//! The position of the table must already be in the 8 bytes at the start of the point data.
+//! @param chunkPoints points of every chunk for a variable chunk size, empty for a fixed one
+bool writeLazChunkTable(std::ostream& stream, const std::vector<uint32_t>& chunkBytes, const std::vector<uint32_t>& chunkPoints = {});
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_LAZ_CHUNK_TABLE_H
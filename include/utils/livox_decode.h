@@ -0,0 +1,39 @@
+#ifndef MANDEYE_MULTISENSOR_LIVOX_DECODE_H
+#define MANDEYE_MULTISENSOR_LIVOX_DECODE_H
+
+#include "livox_types.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace mandeye
+{
+
+//! Points of one packet in the common representation: millimeters, one column per field
+struct DecodedPoints
+{
+	int32_t x[LivoxMaxPointsPerPacket];
+	int32_t y[LivoxMaxPointsPerPacket];
+	int32_t z[LivoxMaxPointsPerPacket];
+	uint8_t reflectivity[LivoxMaxPointsPerPacket];
+	uint8_t tag[LivoxMaxPointsPerPacket];
+};
+
+//! Size in bytes of a single point of the packet data type, 0 for non point data
+size_t livoxPointSize(uint8_t dataType);
+
+//! Decodes the payload of a point packet of any data type, returns the number of decoded points
+size_t decodeLivoxPoints(uint8_t dataType, const uint8_t* payload, size_t count, DecodedPoints& out);
+
+void decodeCartesianHigh(const LivoxLidarCartesianHighRawPoint* in, size_t count, DecodedPoints& out);
+
+//! SIMD kernels, see utils/simd.h for how the kernel is selected
+void decodeCartesianLow(const LivoxLidarCartesianLowRawPoint* in, size_t count, DecodedPoints& out);
+void decodeSpherical(const LivoxLidarSpherPoint* in, size_t count, DecodedPoints& out);
+
+//! Plain C++ reference versions of the kernels
+void decodeCartesianLowScalar(const LivoxLidarCartesianLowRawPoint* in, size_t count, DecodedPoints& out);
+void decodeSphericalScalar(const LivoxLidarSpherPoint* in, size_t count, DecodedPoints& out);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_LIVOX_DECODE_H
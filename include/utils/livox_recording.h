@@ -0,0 +1,134 @@
+#ifndef MANDEYE_MULTISENSOR_LIVOX_RECORDING_H
+#define MANDEYE_MULTISENSOR_LIVOX_RECORDING_H
+
+#include "utils/SpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <livox_lidar_def.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Recording file layout: "MDLVXREC" and a uint32 version, then records of LivoxRecordHeader followed by `size` bytes.
+//! Point and IMU records hold the LivoxLidarEthernetPacket as received, lidar info records hold LivoxLidarInfo.
+enum class LivoxRecordKind : uint8_t
+{
+	Points = 0,
+	Imu = 1,
+	LidarInfo = 2,
+};
+
+#pragma pack(push, 1)
+struct LivoxRecordHeader
+{
+	uint64_t arrival; // ns since the recording started
+	uint32_t handle;
+	uint16_t size;
+	uint8_t kind;
+	uint8_t devType;
+};
+#pragma pack(pop)
+
+//! biggest record, an ethernet packet with a full payload of high precision points
+constexpr size_t LivoxMaxRecordSize = 2048;
+
+//! Bytes of a point or IMU packet as delivered by the SDK, header and used part of the data
+size_t livoxEthernetPacketSize(const LivoxLidarEthernetPacket* packet);
+
+//! Records what the Livox SDK callbacks receive.
+//! `record` copies the record into a preallocated ring per kind and never blocks the SDK thread,
+//! a full ring drops the record and counts it. A writer thread merges the rings by arrival and flushes them to the file every 100 ms,
+//! holding back the last 100 ms so the file stays in arrival order across flushes.
+//! Each kind must be recorded from a single thread, as the SDK delivers them.
+class LivoxPacketRecorder
+{
+public:
+	explicit LivoxPacketRecorder(const std::string& path);
+	~LivoxPacketRecorder();
+
+	bool isOpen() const
+	{
+		return m_file.is_open();
+	}
+
+	void record(LivoxRecordKind kind, uint32_t handle, uint8_t devType, const void* data, size_t size);
+
+	//! records written to the file
+	uint64_t records() const
+	{
+		return m_records.load(std::memory_order_relaxed);
+	}
+
+	//! records lost because the writer fell behind and their ring was full
+	uint64_t dropped() const
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Record
+	{
+		LivoxRecordHeader header;
+		uint8_t data[LivoxMaxRecordSize];
+	};
+	//! about 0.5 s of MID360 point packets from 4 lidars, the writer empties the rings every 100 ms.
+	//! Lidar info only changes when lidars come and go.
+	static constexpr size_t PointsRingCapacity = 4096;
+	static constexpr size_t ImuRingCapacity = 1024;
+	static constexpr size_t InfoRingCapacity = 64;
+
+	void writerThread();
+	//! writes the queued records older than a flush period, or all of them, in arrival order
+	void flush(bool all);
+
+	std::ofstream m_file;
+	const std::chrono::steady_clock::time_point m_start;
+	utils::SpscRing<Record> m_points{PointsRingCapacity};
+	utils::SpscRing<Record> m_imu{ImuRingCapacity};
+	utils::SpscRing<Record> m_info{InfoRingCapacity};
+	std::vector<char> m_staged; // records not written yet, used by the writer thread only
+	std::vector<std::pair<uint64_t, size_t>> m_order; // arrival and offset in m_staged
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_done{false}; // guarded by m_mutex
+	std::atomic<uint64_t> m_records{0};
+	std::atomic<uint64_t> m_dropped{0};
+	std::thread m_writer;
+};
+
+//! Reads a recording back record by record
+class LivoxRecordingReader
+{
+public:
+	static constexpr size_t MaxRecordSize = LivoxMaxRecordSize;
+
+	explicit LivoxRecordingReader(const std::string& path);
+
+	bool isOpen() const
+	{
+		return m_valid;
+	}
+
+	//! Reads the next record, the payload is copied into `data` which must hold MaxRecordSize bytes
+	//! @return false at the end of the file
+	bool next(LivoxRecordHeader& header, uint8_t* data);
+
+	//! starts reading from the first record again
+	void rewind();
+
+private:
+	std::ifstream m_file;
+	std::streampos m_firstRecord;
+	bool m_valid{false};
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_LIVOX_RECORDING_H
@@ -0,0 +1,58 @@
+#ifndef MANDEYE_MULTISENSOR_POINT_FILTER_H
+#define MANDEYE_MULTISENSOR_POINT_FILTER_H
+
+#include "utils/livox_decode.h"
+#include <cstddef>
+#include <cstdint>
+#include <json.hpp>
+#include <string>
+
+namespace mandeye
+{
+
+//! Ingestion time point filter, distances in millimeters.
+//! A point is rejected when any enabled test fails.
+struct PointFilterConfig
+{
+	bool enabled{false};
+	//! keeps points with minRange <= range <= maxRange, maxRange 0 means no upper limit
+	uint32_t minRange{0};
+	uint32_t maxRange{0};
+	//! rejects points inside the box, e.g. the mounting pole
+	bool excludeBox{false};
+	int32_t boxMin[3]{};
+	int32_t boxMax[3]{};
+	//! rejects points with any of these tag bits set
+	uint8_t rejectTagMask{0};
+	//! rejects points with a lower reflectivity
+	uint8_t minReflectivity{0};
+};
+
+//! Parses the filter from JSON, distances in meters:
+//! {"min_range": 0.1, "max_range": 70, "exclude_box": {"min": [x, y, z], "max": [x, y, z]}, "reject_tag_mask": 12, "min_reflectivity": 1}
+//! Missing keys disable the test, an empty object disables the filter.
+//! Values out of range reject the whole config, the filter is then disabled.
+PointFilterConfig pointFilterConfigFromJson(const nlohmann::json& json);
+
+//! Reads the filter from an inline JSON object or from a JSON file, an empty string disables the filter
+PointFilterConfig pointFilterConfigFromString(const std::string& jsonOrPath);
+
+nlohmann::json pointFilterConfigToJson(const PointFilterConfig& config);
+
+//! Number of points rejected by each test, a point failing several tests counts in each of them
+struct PointFilterCounters
+{
+	uint64_t range{0};
+	uint64_t box{0};
+	uint64_t tag{0};
+	uint64_t reflectivity{0};
+	uint64_t rejected{0};
+};
+
+//! Computes which of the decoded points pass the filter, `keep[i]` is 1 for kept points.
+//! Returns the number of kept points.
+size_t filterPoints(const PointFilterConfig& config, const DecodedPoints& points, size_t count, uint8_t* keep, PointFilterCounters& counters);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_POINT_FILTER_H
@@ -0,0 +1,23 @@
+#ifndef MANDEYE_MULTISENSOR_RAW_POINTS_H
+#define MANDEYE_MULTISENSOR_RAW_POINTS_H
+
+#include "livox_types.h"
+#include <string>
+
+namespace mandeye
+{
+
+//! Extension of raw point files, lidarNNNN.laz is written next to them when they are transcoded
+constexpr const char* RawPointsExtension = ".mdpts";
+
+//! Writes the columns of a buffer as they are in memory: a header with the point stats, then every column
+//! starting at a multiple of 8 bytes, so a reader can map the file instead of parsing it.
+//! Costs a memcpy per column, the CPU is left to the lidar while scanning.
+bool saveRawPoints(const std::string& filename, const LivoxPointsBuffer& buffer);
+
+//! Reads a file of saveRawPoints, replacing the content of `buffer`
+bool loadRawPoints(const std::string& filename, LivoxPointsBuffer& buffer);
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_RAW_POINTS_H
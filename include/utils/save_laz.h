@@ -1,7 +1,122 @@
 #pragma once
-#include "clients/concrete/LivoxClient.h"
+#include "livox_types.h"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
 #include <string>
+#include <thread>
 namespace mandeye
 {
-bool saveLaz(const std::string& filename, const LivoxPointsBufferPtr& buffer);
-}
\ No newline at end of file
+//! points per LASzip chunk, the unit of work of saveLazParallel
+constexpr size_t LazChunkPoints = 50000;
+
+//! point record layout of the written files
+enum class LasFormat
+{
+	//! LAS 1.2 point format 1: laser_id in user_data, tag in classification, GPS time as epoch seconds
+	Las12Format1,
+	//! LAS 1.4 point format 6 with line_id, laser_id and tag as extra bytes, compressed in layers.
+	//! GPS time is seconds from the time base in the "mandeye" VLR 1 (uint64 epoch ns), so it keeps nanoseconds.
+	Las14Format6,
+	//! cloud optimized point cloud of point format 6 records, one LAZ chunk per octree node
+	Copc,
+};
+
+//! "1", "6" or "copc"
+LasFormat lasFormatFromString(const std::string& format);
+
+//! ".copc.laz" for COPC, ".laz" otherwise
+const char* lazExtension(LasFormat format);
+
+//! saveLaz and saveLazParallel keep every step-th point, chunks above 4M points are decimated to about 2M
+size_t lazDecimationStep(size_t points);
+
+bool saveLaz(const std::string& filename, const LivoxPointsBufferPtr& buffer, LasFormat format = LasFormat::Las12Format1);
+
+//! Same points as saveLaz, decimated alike. LASzip chunks are compressed on `threads` threads and concatenated,
+//! falls back to saveLaz for a single thread, a single chunk or uncompressed output.
+bool saveLazParallel(const std::string& filename, const LivoxPointsBufferPtr& buffer, unsigned threads, LasFormat format = LasFormat::Las12Format1);
+
+//! Writes a COPC file: builds the octree (buildCopcOctree) and compresses its nodes on `threads` threads.
+//! Viewers stream it without indexing it first.
+bool saveCopc(const std::string& filename, const LivoxPointsBufferPtr& buffer, unsigned threads);
+
+//! Appends the points of a file written by saveLaz or saveCopc to `buffer`
+bool loadLaz(const std::string& filename, LivoxPointsBuffer& buffer);
+
+//! File of a LazStream, complete once everything pushed before its rotation is compressed
+class LazStreamFile
+{
+public:
+	LazStreamFile(std::filesystem::path path, std::shared_future<bool> closed, const LivoxPointsStats& stats)
+		: m_path(std::move(path))
+		, m_closed(std::move(closed))
+		, m_stats(stats)
+	{ }
+
+	//! waits for the file to be closed and moves it to `destination`
+	bool moveTo(const std::filesystem::path& destination);
+
+	//! of every point pushed to the file
+	const LivoxPointsStats& stats() const
+	{
+		return m_stats;
+	}
+
+private:
+	std::filesystem::path m_path;
+	std::shared_future<bool> m_closed;
+	const LivoxPointsStats m_stats;
+};
+
+//! LAZ file written while the points arrive. A background thread compresses the pushed blocks,
+//! so closing a chunk only costs the last block. Files are created in `directory` and moved to their chunk when saved.
+//! An octree needs all points, COPC is streamed as plain point format 6.
+class LazStream
+{
+public:
+	explicit LazStream(std::filesystem::path directory, LasFormat format = LasFormat::Las12Format1);
+	~LazStream();
+
+	void push(LivoxPointsBufferConstPtr block);
+
+	//! ends the current file, points pushed afterwards go to a new one.
+	//! nullptr when nothing was pushed since the last rotate, there is no file then
+	std::shared_ptr<LazStreamFile> rotate();
+
+	//! ends the current file and deletes it, for points pushed after the last chunk of a session
+	void discard();
+
+	//! points pushed and not compressed yet
+	size_t queuedPoints() const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return m_queuedPoints;
+	}
+
+private:
+	struct Item
+	{
+		std::filesystem::path path; // file the item belongs to
+		LivoxPointsBufferConstPtr block; // or the end of the file
+		std::promise<bool> closed;
+		bool discard{false}; // the file is deleted once closed
+	};
+
+	void compressorThread();
+
+	const std::filesystem::path m_directory;
+	const LasFormat m_format;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<Item> m_items; // guarded by m_mutex
+	size_t m_queuedPoints{0}; // guarded by m_mutex
+	bool m_done{false}; // guarded by m_mutex
+	size_t m_files{0}; // guarded by m_mutex
+	std::filesystem::path m_currentPath; // guarded by m_mutex, file receiving the pushed blocks
+	LivoxPointsStats m_currentStats; // guarded by m_mutex, of the blocks pushed to m_currentPath
+	std::thread m_thread;
+};
+}
@@ -0,0 +1,344 @@
+#ifndef MANDEYE_MULTISENSOR_SIMD_H
+#define MANDEYE_MULTISENSOR_SIMD_H
+
+//! Minimal portable 4-lane SIMD layer used by the packet decoders.
+//! The kernel is picked at compile time from the target: SSE2 on x86, NEON on ARM, plain C++ otherwise.
+//! Configure with -DMANDEYE_SIMD=OFF to force the scalar kernel.
+
+#include <cmath>
+#include <cstdint>
+
+#if !defined(MANDEYE_SIMD_DISABLE) && (defined(__SSE2__) || defined(_M_X64))
+#	define MANDEYE_SIMD_SSE2 1
+#	include <emmintrin.h>
+#	ifdef __SSE4_1__
+#		include <smmintrin.h>
+#	endif
+#elif !defined(MANDEYE_SIMD_DISABLE) && defined(__ARM_NEON)
+#	define MANDEYE_SIMD_NEON 1
+#	include <arm_neon.h>
+#else
+#	define MANDEYE_SIMD_SCALAR 1
+#endif
+
+namespace simd
+{
+
+#if defined(MANDEYE_SIMD_SSE2)
+
+constexpr const char* KernelName = "sse2";
+using f32x4 = __m128;
+using i32x4 = __m128i;
+
+inline f32x4 load(const float* p)
+{
+	return _mm_loadu_ps(p);
+}
+inline i32x4 load(const int32_t* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline void store(float* p, f32x4 v)
+{
+	_mm_storeu_ps(p, v);
+}
+inline void store(int32_t* p, i32x4 v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+inline f32x4 set1(float v)
+{
+	return _mm_set1_ps(v);
+}
+inline i32x4 set1(int32_t v)
+{
+	return _mm_set1_epi32(v);
+}
+inline f32x4 mul(f32x4 a, f32x4 b)
+{
+	return _mm_mul_ps(a, b);
+}
+inline i32x4 mul(i32x4 a, i32x4 b)
+{
+#	ifdef __SSE4_1__
+	return _mm_mullo_epi32(a, b);
+#	else
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#	endif
+}
+inline i32x4 add(i32x4 a, i32x4 b)
+{
+	return _mm_add_epi32(a, b);
+}
+template <int Bits>
+inline i32x4 shiftLeft(i32x4 v)
+{
+	return _mm_slli_epi32(v, Bits);
+}
+inline f32x4 add(f32x4 a, f32x4 b)
+{
+	return _mm_add_ps(a, b);
+}
+inline f32x4 toFloat(i32x4 v)
+{
+	return _mm_cvtepi32_ps(v);
+}
+//! Round to nearest
+inline i32x4 toInt(f32x4 v)
+{
+	return _mm_cvtps_epi32(v);
+}
+
+//! Loads 4 records of 4 int16 (16 values) and returns the 4 fields as sign extended int32 columns
+inline void deinterleave4x16(const int16_t* src, i32x4& a, i32x4& b, i32x4& c, i32x4& d)
+{
+	const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); // a0 b0 c0 d0 a1 b1 c1 d1
+	const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8)); // a2 b2 c2 d2 a3 b3 c3 d3
+	const __m128i t0 = _mm_unpacklo_epi16(r0, r1); // a0 a2 b0 b2 c0 c2 d0 d2
+	const __m128i t1 = _mm_unpackhi_epi16(r0, r1); // a1 a3 b1 b3 c1 c3 d1 d3
+	const __m128i ab = _mm_unpacklo_epi16(t0, t1); // a0 a1 a2 a3 b0 b1 b2 b3
+	const __m128i cd = _mm_unpackhi_epi16(t0, t1); // c0 c1 c2 c3 d0 d1 d2 d3
+	a = _mm_srai_epi32(_mm_unpacklo_epi16(ab, ab), 16);
+	b = _mm_srai_epi32(_mm_unpackhi_epi16(ab, ab), 16);
+	c = _mm_srai_epi32(_mm_unpacklo_epi16(cd, cd), 16);
+	d = _mm_srai_epi32(_mm_unpackhi_epi16(cd, cd), 16);
+}
+
+//! Comparisons return all ones lanes where true
+inline i32x4 greater(i32x4 a, i32x4 b)
+{
+	return _mm_cmpgt_epi32(a, b);
+}
+inline i32x4 greater(f32x4 a, f32x4 b)
+{
+	return _mm_castps_si128(_mm_cmpgt_ps(a, b));
+}
+inline i32x4 bitAnd(i32x4 a, i32x4 b)
+{
+	return _mm_and_si128(a, b);
+}
+inline i32x4 bitOr(i32x4 a, i32x4 b)
+{
+	return _mm_or_si128(a, b);
+}
+//! One bit per lane of a comparison result, lane 0 in bit 0
+inline int moveMask(i32x4 v)
+{
+	return _mm_movemask_ps(_mm_castsi128_ps(v));
+}
+
+#elif defined(MANDEYE_SIMD_NEON)
+
+constexpr const char* KernelName = "neon";
+using f32x4 = float32x4_t;
+using i32x4 = int32x4_t;
+
+inline f32x4 load(const float* p)
+{
+	return vld1q_f32(p);
+}
+inline i32x4 load(const int32_t* p)
+{
+	return vld1q_s32(p);
+}
+inline void store(float* p, f32x4 v)
+{
+	vst1q_f32(p, v);
+}
+inline void store(int32_t* p, i32x4 v)
+{
+	vst1q_s32(p, v);
+}
+inline f32x4 set1(float v)
+{
+	return vdupq_n_f32(v);
+}
+inline i32x4 set1(int32_t v)
+{
+	return vdupq_n_s32(v);
+}
+inline f32x4 mul(f32x4 a, f32x4 b)
+{
+	return vmulq_f32(a, b);
+}
+inline i32x4 mul(i32x4 a, i32x4 b)
+{
+	return vmulq_s32(a, b);
+}
+inline i32x4 add(i32x4 a, i32x4 b)
+{
+	return vaddq_s32(a, b);
+}
+template <int Bits>
+inline i32x4 shiftLeft(i32x4 v)
+{
+	return vshlq_n_s32(v, Bits);
+}
+inline f32x4 add(f32x4 a, f32x4 b)
+{
+	return vaddq_f32(a, b);
+}
+inline f32x4 toFloat(i32x4 v)
+{
+	return vcvtq_f32_s32(v);
+}
+//! Round to nearest
+inline i32x4 toInt(f32x4 v)
+{
+#	if defined(__aarch64__)
+	return vcvtnq_s32_f32(v);
+#	else
+	// armv7 only truncates, add +-0.5 first
+	const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000u));
+	const float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), sign));
+	return vcvtq_s32_f32(vaddq_f32(v, half));
+#	endif
+}
+
+//! Loads 4 records of 4 int16 (16 values) and returns the 4 fields as sign extended int32 columns
+inline void deinterleave4x16(const int16_t* src, i32x4& a, i32x4& b, i32x4& c, i32x4& d)
+{
+	const int16x4x4_t r = vld4_s16(src);
+	a = vmovl_s16(r.val[0]);
+	b = vmovl_s16(r.val[1]);
+	c = vmovl_s16(r.val[2]);
+	d = vmovl_s16(r.val[3]);
+}
+
+//! Comparisons return all ones lanes where true
+inline i32x4 greater(i32x4 a, i32x4 b)
+{
+	return vreinterpretq_s32_u32(vcgtq_s32(a, b));
+}
+inline i32x4 greater(f32x4 a, f32x4 b)
+{
+	return vreinterpretq_s32_u32(vcgtq_f32(a, b));
+}
+inline i32x4 bitAnd(i32x4 a, i32x4 b)
+{
+	return vandq_s32(a, b);
+}
+inline i32x4 bitOr(i32x4 a, i32x4 b)
+{
+	return vorrq_s32(a, b);
+}
+//! One bit per lane of a comparison result, lane 0 in bit 0
+inline int moveMask(i32x4 v)
+{
+	const int32x4_t bits = {1, 2, 4, 8};
+	const int32x4_t lanes = vandq_s32(v, bits);
+	const int32x2_t pairs = vadd_s32(vget_low_s32(lanes), vget_high_s32(lanes));
+	return vget_lane_s32(vpadd_s32(pairs, pairs), 0);
+}
+
+#else
+
+constexpr const char* KernelName = "scalar";
+struct f32x4
+{
+	float v[4];
+};
+struct i32x4
+{
+	int32_t v[4];
+};
+
+inline f32x4 load(const float* p)
+{
+	return {{p[0], p[1], p[2], p[3]}};
+}
+inline i32x4 load(const int32_t* p)
+{
+	return {{p[0], p[1], p[2], p[3]}};
+}
+inline void store(float* p, f32x4 a)
+{
+	for(int i = 0; i < 4; i++)
+		p[i] = a.v[i];
+}
+inline void store(int32_t* p, i32x4 a)
+{
+	for(int i = 0; i < 4; i++)
+		p[i] = a.v[i];
+}
+inline f32x4 set1(float v)
+{
+	return {{v, v, v, v}};
+}
+inline i32x4 set1(int32_t v)
+{
+	return {{v, v, v, v}};
+}
+inline f32x4 mul(f32x4 a, f32x4 b)
+{
+	return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+inline i32x4 mul(i32x4 a, i32x4 b)
+{
+	return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+inline i32x4 add(i32x4 a, i32x4 b)
+{
+	return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+template <int Bits>
+inline i32x4 shiftLeft(i32x4 a)
+{
+	return {{a.v[0] << Bits, a.v[1] << Bits, a.v[2] << Bits, a.v[3] << Bits}};
+}
+inline f32x4 add(f32x4 a, f32x4 b)
+{
+	return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+inline f32x4 toFloat(i32x4 a)
+{
+	return {{float(a.v[0]), float(a.v[1]), float(a.v[2]), float(a.v[3])}};
+}
+//! Round to nearest
+inline i32x4 toInt(f32x4 a)
+{
+	return {{int32_t(std::lround(a.v[0])), int32_t(std::lround(a.v[1])), int32_t(std::lround(a.v[2])), int32_t(std::lround(a.v[3]))}};
+}
+
+//! Loads 4 records of 4 int16 (16 values) and returns the 4 fields as sign extended int32 columns
+inline void deinterleave4x16(const int16_t* src, i32x4& a, i32x4& b, i32x4& c, i32x4& d)
+{
+	for(int i = 0; i < 4; i++)
+	{
+		a.v[i] = src[4 * i];
+		b.v[i] = src[4 * i + 1];
+		c.v[i] = src[4 * i + 2];
+		d.v[i] = src[4 * i + 3];
+	}
+}
+
+//! Comparisons return all ones lanes where true
+inline i32x4 greater(i32x4 a, i32x4 b)
+{
+	return {{-(a.v[0] > b.v[0]), -(a.v[1] > b.v[1]), -(a.v[2] > b.v[2]), -(a.v[3] > b.v[3])}};
+}
+inline i32x4 greater(f32x4 a, f32x4 b)
+{
+	return {{-(a.v[0] > b.v[0]), -(a.v[1] > b.v[1]), -(a.v[2] > b.v[2]), -(a.v[3] > b.v[3])}};
+}
+inline i32x4 bitAnd(i32x4 a, i32x4 b)
+{
+	return {{a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3]}};
+}
+inline i32x4 bitOr(i32x4 a, i32x4 b)
+{
+	return {{a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3]}};
+}
+//! One bit per lane of a comparison result, lane 0 in bit 0
+inline int moveMask(i32x4 a)
+{
+	return (a.v[0] & 1) | (a.v[1] & 2) | (a.v[2] & 4) | (a.v[3] & 8);
+}
+
+#endif
+
+} // namespace simd
+
+#endif //MANDEYE_MULTISENSOR_SIMD_H
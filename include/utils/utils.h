@@ -1,13 +1,55 @@
 #ifndef MANDEYE_MULTISENSOR_UTILS_H
 #define MANDEYE_MULTISENSOR_UTILS_H
 #include "clients/concrete/GpioClient.h"
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <type_traits>
 
 namespace utils
 {
 std::string getEnvString(const std::string& env, const std::string& def);
 bool getEnvBool(const std::string& env, bool def);
+
+//! Number from the environment within [min, max]. Garbage, fractions for integers and values out of range
+//! are logged and replaced by the compiled default `def`.
+template <typename T>
+T getEnvNumber(const std::string& env, const std::string& def, T min, T max)
+{
+	const auto parse = [min, max](const std::string& text, T& value) {
+		if(text.empty())
+		{
+			return false;
+		}
+		char* end = nullptr;
+		errno = 0;
+		if constexpr(std::is_integral_v<T>)
+		{
+			const long long parsed = std::strtoll(text.c_str(), &end, 10);
+			value = static_cast<T>(parsed);
+			return errno == 0 && *end == '\0' && parsed >= static_cast<long long>(min) && parsed <= static_cast<long long>(max);
+		}
+		else
+		{
+			value = static_cast<T>(std::strtod(text.c_str(), &end));
+			return errno == 0 && *end == '\0' && value >= min && value <= max;
+		}
+	};
+	T value{};
+	const std::string text = getEnvString(env, def);
+	if(parse(text, value))
+	{
+		return value;
+	}
+	std::cerr << "Invalid " << env << " '" << text << "', expected " << +min << " to " << +max << ", using " << def << std::endl;
+	parse(def, value);
+	return value;
+}
+
 void blinkLed(mandeye::LED led, std::chrono::milliseconds mills);
-void syncDisk();
+//! Flushes only the filesystem holding `path` (syncfs), written files and directory entries alike
+bool syncFilesystem(const std::string& path);
 std::vector<int> getIntListFromEnvVar(const std::string& env, const std::string& def);
 }
 #endif //MANDEYE_MULTISENSOR_UTILS_H
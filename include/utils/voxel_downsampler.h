@@ -0,0 +1,62 @@
+#ifndef MANDEYE_MULTISENSOR_VOXEL_DOWNSAMPLER_H
+#define MANDEYE_MULTISENSOR_VOXEL_DOWNSAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mandeye
+{
+
+//! Voxel grid settings, leafSize in millimeters, 0 disables downsampling
+struct VoxelGridConfig
+{
+	uint32_t leafSize{0};
+	uint8_t pointsPerVoxel{1};
+};
+
+//! Streaming voxel grid downsampler: keeps the first `pointsPerVoxel` points that fall in each voxel.
+//! Points are decided one by one as they arrive, so the cost is spread over ingestion
+//! and the kept points are the earliest ones of each voxel.
+//! The voxel set is a flat open addressing table, `clear` keeps its memory for the next chunk.
+class VoxelDownsampler
+{
+public:
+	explicit VoxelDownsampler(const VoxelGridConfig& config);
+
+	bool enabled() const
+	{
+		return m_config.leafSize != 0;
+	}
+
+	//! true when the point is kept, coordinates in millimeters
+	bool accept(int32_t x, int32_t y, int32_t z);
+
+	//! forgets all voxels, called at chunk boundaries
+	void clear();
+
+	//! number of occupied voxels
+	size_t voxels() const
+	{
+		return m_occupied;
+	}
+
+private:
+	static constexpr uint64_t EmptyKey = ~uint64_t(0);
+	static constexpr int InitialBits = 16;
+	static constexpr size_t InitialCapacity = size_t(1) << InitialBits;
+
+	uint64_t voxelKey(int32_t x, int32_t y, int32_t z) const;
+	void grow();
+
+	VoxelGridConfig m_config;
+	std::vector<uint64_t> m_keys;
+	std::vector<uint8_t> m_counts;
+	size_t m_mask{0};
+	int m_bits{0};
+	size_t m_occupied{0};
+};
+
+} // namespace mandeye
+
+#endif //MANDEYE_MULTISENSOR_VOXEL_DOWNSAMPLER_H
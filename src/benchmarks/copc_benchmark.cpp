@@ -0,0 +1,236 @@
+// Compares writing a chunk as COPC with the plain LAZ writer: octree build alone, COPC file, LAZ file.
+// Checks the COPC file the way a COPC reader uses it: info VLR first, variable LASzip chunks, hierarchy EVLR
+// whose entries tile the point data, every node's points inside its cube; then loadLaz reads every point back.
+// usage: copc_benchmark [points] [threads] [directory]
+#include "laszip/laszip_api.h"
+#include "utils/copc_octree.h"
+#include "utils/save_laz.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace mandeye;
+
+LivoxPointsBufferPtr makeBuffer(size_t points)
+{
+	auto buffer = std::make_shared<LivoxPointsBuffer>();
+	buffer->reserve(points, points / LivoxMaxPointsPerPacket + 1);
+	std::mt19937 rng(42);
+	std::normal_distribution<double> noise(0, 5);
+	uint64_t timestamp = 1700000000000000000ull;
+	for(size_t i = 0; i < points; i++)
+	{
+		if(i % LivoxMaxPointsPerPacket == 0)
+		{
+			buffer->beginPacket(timestamp);
+			timestamp += 480000;
+		}
+		// scan of a room, walls at 3 to 8 m
+		const double angle = i * 0.0137;
+		const double range = 5000 + 3000 * std::sin(i * 1e-4);
+		buffer->push(static_cast<int32_t>(range * std::cos(angle) + noise(rng)),
+					 static_cast<int32_t>(range * std::sin(angle) + noise(rng)),
+					 static_cast<int32_t>(1500 * std::sin(angle * 0.01) + noise(rng)),
+					 static_cast<uint8_t>(i),
+					 0,
+					 i % LivoxMid360Lines,
+					 0,
+					 (i % LivoxMaxPointsPerPacket) * 5000);
+	}
+	return buffer;
+}
+
+template <typename T>
+T readAt(const std::string& bytes, size_t position)
+{
+	T value{};
+	if(position + sizeof(T) <= bytes.size())
+	{
+		std::memcpy(&value, bytes.data() + position, sizeof(T));
+	}
+	return value;
+}
+
+struct HierarchyEntry
+{
+	int32_t d, x, y, z;
+	uint64_t offset;
+	int32_t byteSize;
+	int32_t pointCount;
+};
+
+//! the checks of a COPC reader and validator, from the bytes and through LASzip
+bool verifyCopc(const std::string& filename, uint64_t points)
+{
+	std::ifstream in(filename, std::ios::binary);
+	const std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const auto fail = [&](const char* what) {
+		std::cerr << filename << ": " << what << std::endl;
+		return false;
+	};
+	const auto headerSize = readAt<uint16_t>(bytes, 94);
+	const auto pointData = readAt<uint32_t>(bytes, 96);
+	if(bytes.compare(0, 4, "LASF") != 0 || readAt<uint8_t>(bytes, 25) != 4 || headerSize != 375 || (readAt<uint8_t>(bytes, 104) & 0x3f) != 6 ||
+	   (readAt<uint16_t>(bytes, 6) & (1 << 4)) == 0 || readAt<uint64_t>(bytes, 247) != points)
+	{
+		return fail("not a LAS 1.4 point format 6 header with the WKT bit and the point count");
+	}
+	// the COPC info is the first VLR, right after the header
+	if(bytes.compare(headerSize + 2, 4, "copc") != 0 || readAt<uint16_t>(bytes, headerSize + 18) != 1 || readAt<uint16_t>(bytes, headerSize + 20) != 160)
+	{
+		return fail("COPC info is not the first VLR");
+	}
+	const size_t info = headerSize + 54;
+	const double center[3] = {readAt<double>(bytes, info), readAt<double>(bytes, info + 8), readAt<double>(bytes, info + 16)};
+	const double halfSize = readAt<double>(bytes, info + 24);
+	const auto hierarchyOffset = readAt<uint64_t>(bytes, info + 40);
+	const auto hierarchySize = readAt<uint64_t>(bytes, info + 48);
+	size_t vlr = headerSize;
+	uint32_t chunkSize = 0;
+	for(uint32_t v = 0; v < readAt<uint32_t>(bytes, 100); v++)
+	{
+		if(bytes.compare(vlr + 2, 14, "laszip encoded") == 0 && readAt<uint16_t>(bytes, vlr + 18) == 22204)
+		{
+			chunkSize = readAt<uint32_t>(bytes, vlr + 54 + 12);
+		}
+		vlr += 54 + readAt<uint16_t>(bytes, vlr + 20);
+	}
+	if(chunkSize != UINT32_MAX || vlr > pointData)
+	{
+		return fail("LASzip chunks are not variable");
+	}
+	// the hierarchy EVLR
+	size_t evlr = readAt<uint64_t>(bytes, 235);
+	size_t hierarchy = 0;
+	for(uint32_t e = 0; e < readAt<uint32_t>(bytes, 243) && evlr + 60 <= bytes.size(); e++)
+	{
+		if(bytes.compare(evlr + 2, 4, "copc") == 0 && readAt<uint16_t>(bytes, evlr + 18) == 1000 && readAt<uint64_t>(bytes, evlr + 20) == hierarchySize)
+		{
+			hierarchy = evlr + 60;
+		}
+		evlr += 60 + readAt<uint64_t>(bytes, evlr + 20);
+	}
+	if(hierarchy == 0 || hierarchy != hierarchyOffset || hierarchySize % sizeof(HierarchyEntry) != 0 || hierarchy + hierarchySize > bytes.size())
+	{
+		return fail("COPC info does not point at the hierarchy EVLR");
+	}
+	std::vector<HierarchyEntry> entries(hierarchySize / sizeof(HierarchyEntry));
+	std::memcpy(entries.data(), bytes.data() + hierarchy, hierarchySize);
+
+	// node chunks follow the chunk table offset without gaps, the chunk table follows the last one
+	std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+	std::map<std::tuple<int32_t, int32_t, int32_t, int32_t>, int32_t> keys;
+	uint64_t next = pointData + sizeof(int64_t);
+	uint64_t total = 0;
+	for(const auto& entry : entries)
+	{
+		if(entry.offset != next || entry.byteSize <= 0 || entry.pointCount <= 0 || !keys.emplace(std::make_tuple(entry.d, entry.x, entry.y, entry.z), entry.pointCount).second)
+		{
+			return fail("hierarchy entries do not tile the point data");
+		}
+		next += entry.byteSize;
+		total += entry.pointCount;
+	}
+	const auto chunkTable = readAt<int64_t>(bytes, pointData);
+	if(static_cast<uint64_t>(chunkTable) != next || total != points || readAt<uint32_t>(bytes, chunkTable + 4) != entries.size())
+	{
+		return fail("hierarchy does not match the chunk table or the point count");
+	}
+	for(const auto& entry : entries)
+	{
+		if(entry.d != 0 && !keys.count(std::make_tuple(entry.d - 1, entry.x / 2, entry.y / 2, entry.z / 2)))
+		{
+			return fail("node without its parent");
+		}
+	}
+
+	// every point lies in the cube of its node
+	laszip_POINTER reader;
+	laszip_BOOL compressed = 0;
+	if(laszip_create(&reader) || laszip_open_reader(reader, filename.c_str(), &compressed))
+	{
+		return fail("LASzip cannot open the file");
+	}
+	bool inside = compressed;
+	laszip_F64 coordinates[3];
+	for(const auto& entry : entries)
+	{
+		const double side = 2 * halfSize / (1 << entry.d);
+		const int32_t position[3] = {entry.x, entry.y, entry.z};
+		for(int32_t p = 0; inside && p < entry.pointCount; p++)
+		{
+			inside = !laszip_read_point(reader) && !laszip_get_coordinates(reader, coordinates);
+			for(int axis = 0; inside && axis < 3; axis++)
+			{
+				const double min = center[axis] - halfSize + position[axis] * side;
+				inside = coordinates[axis] >= min - 1e-3 && coordinates[axis] <= min + side + 1e-3;
+			}
+		}
+	}
+	laszip_close_reader(reader);
+	laszip_destroy(reader);
+	return inside || fail("a point lies outside of its node");
+}
+
+//! every point of the buffer is in the file, in any order
+bool verifyPoints(const std::string& filename, const LivoxPointsBuffer& buffer)
+{
+	LivoxPointsBuffer loaded;
+	if(!loadLaz(filename, loaded) || loaded.size() != buffer.size())
+	{
+		return false;
+	}
+	using Point = std::tuple<int32_t, int32_t, int32_t, uint8_t, uint8_t, uint8_t, uint8_t>;
+	const auto points = [](const LivoxPointsBuffer& b) {
+		std::vector<Point> out(b.size());
+		for(size_t i = 0; i < b.size(); i++)
+		{
+			out[i] = {b.x[i], b.y[i], b.z[i], b.reflectivity[i], b.tag[i], b.line_id[i], b.laser_id[i]};
+		}
+		std::sort(out.begin(), out.end());
+		return out;
+	};
+	return points(loaded) == points(buffer) && loaded.stats.firstTimestamp == buffer.stats.firstTimestamp &&
+		   loaded.stats.lastTimestamp == buffer.stats.lastTimestamp;
+}
+
+template <typename F>
+double seconds(F&& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	const size_t points = argc > 1 ? std::atol(argv[1]) : 4000000;
+	const unsigned threads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+	const std::string directory = argc > 3 ? argv[3] : "/tmp";
+	const auto buffer = makeBuffer(points);
+
+	size_t nodes = 0;
+	const double octreeSeconds = seconds([&]() { nodes = buildCopcOctree(*buffer, threads).nodes.size(); });
+	bool copcSaved = false;
+	const double copcSeconds = seconds([&]() { copcSaved = saveCopc(directory + "/copc_benchmark.copc.laz", buffer, threads); });
+	bool lazSaved = false;
+	const double lazSeconds = seconds([&]() { lazSaved = saveLazParallel(directory + "/copc_benchmark.laz", buffer, threads, LasFormat::Las14Format6); });
+
+	const std::string copcFile = directory + "/copc_benchmark.copc.laz";
+	const bool valid = copcSaved && verifyCopc(copcFile, points) && verifyPoints(copcFile, *buffer);
+
+	std::cout << points << " points on " << threads << " threads" << std::endl;
+	std::cout << "octree:     " << octreeSeconds << " s, " << nodes << " nodes" << std::endl;
+	std::cout << "COPC:       " << copcSeconds << " s, " << points / copcSeconds / 1e6 << " M points/s, " << (valid ? "valid" : "INVALID") << std::endl;
+	std::cout << "plain LAZ:  " << lazSeconds << " s, " << points / lazSeconds / 1e6 << " M points/s" << (lazSaved ? "" : ", FAILED") << std::endl;
+	return valid && lazSaved ? 0 : 1;
+}
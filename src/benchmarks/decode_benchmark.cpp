@@ -0,0 +1,73 @@
+// Measures the Livox packet decoders with the kernel this binary was built for.
+// decode_benchmark_scalar is the same source built with MANDEYE_SIMD_DISABLE, so the table driven
+// kernels run on the plain C++ fallback of utils/simd.h; the SIMD speedup is the ratio of the
+// "kernel" lines of both binaries. The libm line is the double precision reference, reported apart.
+// usage: decode_benchmark [packets]
+#include "utils/livox_decode.h"
+#include "utils/simd.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace mandeye;
+
+template <typename Point, typename Decoder>
+double measureMPointsPerSecond(const std::vector<Point>& points, size_t packets, Decoder decoder, int32_t& checksum)
+{
+	DecodedPoints out;
+	const auto start = std::chrono::steady_clock::now();
+	for(size_t p = 0; p < packets; p++)
+	{
+		const size_t offset = (p * LivoxMaxPointsPerPacket) % (points.size() - LivoxMaxPointsPerPacket);
+		decoder(points.data() + offset, LivoxMaxPointsPerPacket, out);
+		checksum += out.x[p % LivoxMaxPointsPerPacket] + out.z[0];
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return packets * LivoxMaxPointsPerPacket / seconds / 1e6;
+}
+
+template <typename Point>
+int32_t maxDifference(const std::vector<Point>& points,
+					  void (*a)(const Point*, size_t, DecodedPoints&),
+					  void (*b)(const Point*, size_t, DecodedPoints&))
+{
+	DecodedPoints outA, outB;
+	int32_t maxDiff = 0;
+	for(size_t offset = 0; offset + LivoxMaxPointsPerPacket <= points.size(); offset += LivoxMaxPointsPerPacket)
+	{
+		a(points.data() + offset, LivoxMaxPointsPerPacket, outA);
+		b(points.data() + offset, LivoxMaxPointsPerPacket, outB);
+		for(size_t i = 0; i < LivoxMaxPointsPerPacket; i++)
+		{
+			maxDiff = std::max({maxDiff, std::abs(outA.x[i] - outB.x[i]), std::abs(outA.y[i] - outB.y[i]), std::abs(outA.z[i] - outB.z[i])});
+		}
+	}
+	return maxDiff;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t packets = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+	constexpr size_t poolSize = 1024 * LivoxMaxPointsPerPacket;
+
+	std::mt19937 rng(42);
+	std::vector<LivoxLidarCartesianLowRawPoint> low(poolSize);
+	std::vector<LivoxLidarSpherPoint> spherical(poolSize);
+	for(size_t i = 0; i < poolSize; i++)
+	{
+		low[i] = {int16_t(rng() % 8000 - 4000), int16_t(rng() % 8000 - 4000), int16_t(rng() % 2000 - 1000), uint8_t(rng()), uint8_t(rng())};
+		spherical[i] = {uint32_t(rng() % 70000), uint16_t(rng() % 18001), uint16_t(rng() % 36001), uint8_t(rng()), uint8_t(rng())};
+	}
+
+	int32_t checksum = 0;
+	std::cout << "kernel: " << simd::KernelName << ", packets: " << packets << " x " << LivoxMaxPointsPerPacket << " points" << std::endl;
+	std::cout << "cartesian low  kernel: " << measureMPointsPerSecond(low, packets, decodeCartesianLow, checksum) << " Mpts/s" << std::endl;
+	std::cout << "spherical      kernel: " << measureMPointsPerSecond(spherical, packets, decodeSpherical, checksum) << " Mpts/s" << std::endl;
+	std::cout << "spherical      libm  : " << measureMPointsPerSecond(spherical, packets, decodeSphericalScalar, checksum) << " Mpts/s" << std::endl;
+	std::cout << "max difference to the reference, low: " << maxDifference(low, decodeCartesianLow, decodeCartesianLowScalar)
+			  << " mm, spherical: " << maxDifference(spherical, decodeSpherical, decodeSphericalScalar) << " mm" << std::endl;
+	std::cout << "checksum " << checksum << std::endl;
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Compares saving an IMU chunk: the former stringstream + std::endl csv, the to_chars csv formatter, the binary log.
+// Checks the csv text is unchanged and the binary log reads back.
+// usage: imu_log_benchmark [samples] [directory]
+#include "clients/IterableToFileSaver.h"
+#include "utils/imu_log.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace mandeye;
+
+std::string legacyFormat(const LivoxIMU& imu)
+{
+	std::stringstream ss;
+	ss << imu.timestamp << " " << imu.point.gyro_x << " " << imu.point.gyro_y << " " << imu.point.gyro_z << " " << imu.point.acc_x << " "
+	   << imu.point.acc_y << " " << imu.point.acc_z << " " << imu.laser_id;
+	return ss.str();
+}
+
+template <typename F>
+double seconds(F&& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string readFile(const std::filesystem::path& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv)
+{
+	const size_t samples = argc > 1 ? std::atol(argv[1]) : 200000; // 200 Hz, about 17 minutes
+	const std::filesystem::path directory = argc > 2 ? argv[2] : "/tmp";
+
+	LivoxIMUBuffer imu;
+	uint64_t timestamp = 1700000000000000000ull;
+	for(size_t i = 0; i < samples; i++)
+	{
+		LivoxIMU sample{};
+		sample.timestamp = timestamp;
+		sample.point.gyro_x = 0.01f * std::sin(i * 0.01f);
+		sample.point.gyro_y = -0.002f * std::cos(i * 0.003f);
+		sample.point.gyro_z = 1e-5f * i;
+		sample.point.acc_x = 0.05f * std::sin(i * 0.1f);
+		sample.point.acc_y = -0.01f;
+		sample.point.acc_z = 1.0f + 0.001f * std::cos(i * 0.2f);
+		sample.laser_id = i % 2;
+		imu.push_back(sample);
+		timestamp += 5000000;
+	}
+
+	const auto legacyPath = directory / "imu_benchmark_legacy.csv";
+	const double legacySeconds = seconds([&]() {
+		std::ofstream outs(legacyPath);
+		for(const auto& sample : imu)
+			outs << legacyFormat(sample) << std::endl;
+	});
+
+	IterableToFileSaver<LivoxIMUBuffer, ImuCsvFormatter> saver("csv", "imu_benchmark");
+	auto imuCopy = imu;
+	const double csvSeconds = seconds([&]() {
+		saver.setBuffer(std::move(imuCopy));
+		saver.saveDumpedChunkToDirectory(directory.string(), 0);
+	});
+
+	const auto binaryPath = directory / (std::string("imu_benchmark.") + ImuBinaryExtension);
+	bool binarySaved = false;
+	const double binarySeconds = seconds([&]() { binarySaved = saveImuBinary(binaryPath.string(), imu); });
+
+	const bool csvEqual = readFile(legacyPath) == readFile(directory / "imu_benchmark0000.csv");
+	LivoxIMUBuffer readBack;
+	bool binaryEqual = binarySaved && loadImuBinary(binaryPath.string(), readBack) && readBack.size() == imu.size();
+	for(size_t i = 0; binaryEqual && i < imu.size(); i++)
+	{
+		binaryEqual = readBack[i].timestamp == imu[i].timestamp && readBack[i].point.acc_z == imu[i].point.acc_z &&
+					  readBack[i].point.gyro_x == imu[i].point.gyro_x && readBack[i].laser_id == imu[i].laser_id;
+	}
+
+	std::cout << samples << " IMU samples" << std::endl;
+	std::cout << "stringstream csv: " << legacySeconds << " s, " << std::filesystem::file_size(legacyPath) << " bytes" << std::endl;
+	std::cout << "to_chars csv:     " << csvSeconds << " s, " << (csvEqual ? "identical" : "DIFFERENT") << std::endl;
+	std::cout << "binary:           " << binarySeconds << " s, " << std::filesystem::file_size(binaryPath) << " bytes, "
+			  << (binaryEqual ? "valid" : "INVALID") << std::endl;
+	return csvEqual && binaryEqual ? 0 : 1;
+}
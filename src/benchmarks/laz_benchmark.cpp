@@ -0,0 +1,226 @@
+// Measures saveLazParallel against the thread count, with the single LASzip writer of saveLaz as the baseline.
+// Every file is checked three ways: the LAS 1.4 / LAZ structure is parsed from the bytes without LASzip,
+// every point is read back with LASzip and compared with the buffer, and loadLaz reads the file again.
+// A seek into the middle goes through the chunk table.
+// usage: laz_benchmark [points] [max threads] [file] [LAS point format, 1 or 6]
+#include "laszip/laszip_api.h"
+#include "utils/save_laz.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace mandeye;
+
+LivoxPointsBufferPtr makeBuffer(size_t points)
+{
+	auto buffer = std::make_shared<LivoxPointsBuffer>();
+	buffer->reserve(points, points / LivoxMaxPointsPerPacket + 1);
+	std::mt19937 rng(42);
+	std::normal_distribution<double> noise(0, 5);
+	uint64_t timestamp = 1700000000000000000ull;
+	for(size_t i = 0; i < points; i++)
+	{
+		if(i % LivoxMaxPointsPerPacket == 0)
+		{
+			buffer->beginPacket(timestamp);
+			timestamp += 480000;
+		}
+		// scan of a room, walls at 3 to 8 m
+		const double angle = i * 0.0137;
+		const double range = 5000 + 3000 * std::sin(i * 1e-4);
+		buffer->push(static_cast<int32_t>(range * std::cos(angle) + noise(rng)),
+					 static_cast<int32_t>(range * std::sin(angle) + noise(rng)),
+					 static_cast<int32_t>(1500 * std::sin(angle * 0.01) + noise(rng)),
+					 static_cast<uint8_t>(i),
+					 static_cast<uint8_t>(i % 3), // point format 1 keeps the tag in the 5 bit classification
+					 i % LivoxMid360Lines,
+					 static_cast<uint8_t>(i % 2),
+					 (i % LivoxMaxPointsPerPacket) * 5000);
+	}
+	return buffer;
+}
+
+//! epoch ns of every point
+std::vector<uint64_t> timestamps(const LivoxPointsBuffer& buffer)
+{
+	std::vector<uint64_t> out(buffer.size());
+	for(size_t p = 0; p < buffer.packets(); p++)
+	{
+		const size_t end = p + 1 < buffer.packets() ? buffer.packetFirstPoint[p + 1] : buffer.size();
+		for(size_t i = buffer.packetFirstPoint[p]; i < end; i++)
+		{
+			out[i] = buffer.packetTimestamp[p] + buffer.timestampOffset[i];
+		}
+	}
+	return out;
+}
+
+template <typename T>
+T readAt(const std::string& bytes, size_t position)
+{
+	T value{};
+	if(position + sizeof(T) <= bytes.size())
+	{
+		std::memcpy(&value, bytes.data() + position, sizeof(T));
+	}
+	return value;
+}
+
+//! LAS header, LASzip VLR and chunk table pointer, read from the bytes
+bool verifyStructure(const std::string& filename, uint64_t points, LasFormat format)
+{
+	std::ifstream in(filename, std::ios::binary);
+	const std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const bool format6 = format == LasFormat::Las14Format6;
+	const auto headerSize = readAt<uint16_t>(bytes, 94);
+	const auto pointData = readAt<uint32_t>(bytes, 96);
+	const auto vlrs = readAt<uint32_t>(bytes, 100);
+	bool ok = bytes.compare(0, 4, "LASF") == 0 && readAt<uint8_t>(bytes, 25) == (format6 ? 4 : 2) && headerSize == (format6 ? 375 : 227);
+	ok = ok && (readAt<uint8_t>(bytes, 104) & 0x3f) == (format6 ? 6 : 1) && (readAt<uint8_t>(bytes, 104) & 0x80) != 0; // compressed
+	ok = ok && (format6 ? (readAt<uint16_t>(bytes, 6) & (1 << 4)) != 0 && readAt<uint32_t>(bytes, 107) == 0 && readAt<uint64_t>(bytes, 247) == points
+						: readAt<uint32_t>(bytes, 107) == points);
+	// the LASzip VLR declares the chunk size the chunk table was written for
+	size_t vlr = headerSize;
+	uint32_t chunkSize = 0;
+	for(uint32_t v = 0; ok && v < vlrs; v++)
+	{
+		const auto length = readAt<uint16_t>(bytes, vlr + 20);
+		if(bytes.compare(vlr + 2, 14, "laszip encoded") == 0 && readAt<uint16_t>(bytes, vlr + 18) == 22204)
+		{
+			chunkSize = readAt<uint32_t>(bytes, vlr + 54 + 12);
+		}
+		vlr += 54 + length;
+	}
+	ok = ok && vlr <= pointData && chunkSize == LazChunkPoints;
+	// the point data starts with the offset of the chunk table, which follows the last chunk
+	const auto chunkTable = readAt<int64_t>(bytes, pointData);
+	ok = ok && chunkTable > static_cast<int64_t>(pointData) + 8 && static_cast<uint64_t>(chunkTable) + 8 <= bytes.size();
+	ok = ok && readAt<uint32_t>(bytes, chunkTable) == 0 && readAt<uint32_t>(bytes, chunkTable + 4) == (points + chunkSize - 1) / chunkSize;
+	if(!ok)
+	{
+		std::cerr << "structure of " << filename << " is not valid" << std::endl;
+	}
+	return ok;
+}
+
+//! reads every point in order, then seeks to the middle through the chunk table
+bool verifyPoints(const std::string& filename, const LivoxPointsBuffer& buffer, const std::vector<uint64_t>& times, LasFormat format)
+{
+	laszip_POINTER reader;
+	laszip_BOOL compressed = 0;
+	if(laszip_create(&reader) || laszip_open_reader(reader, filename.c_str(), &compressed))
+	{
+		return false;
+	}
+	laszip_header* header;
+	laszip_point* point;
+	laszip_get_header_pointer(reader, &header);
+	laszip_get_point_pointer(reader, &point);
+	const bool format6 = format == LasFormat::Las14Format6;
+	const size_t step = lazDecimationStep(buffer.size());
+	const uint64_t points = (buffer.size() + step - 1) / step;
+	const uint64_t base = times.empty() ? 0 : *std::min_element(times.begin(), times.end());
+	bool ok = compressed && (format6 ? header->extended_number_of_point_records : header->number_of_point_records) == points;
+	const auto check = [&](size_t p) {
+		const size_t i = p * step;
+		laszip_F64 coordinates[3];
+		bool same = !laszip_read_point(reader) && !laszip_get_coordinates(reader, coordinates);
+		same = same && std::lround(coordinates[0] * 1000) == buffer.x[i] && std::lround(coordinates[1] * 1000) == buffer.y[i] &&
+			   std::lround(coordinates[2] * 1000) == buffer.z[i] && point->intensity == buffer.reflectivity[i];
+		if(format6)
+		{
+			same = same && point->num_extra_bytes == 3 && point->extra_bytes[0] == buffer.line_id[i] && point->extra_bytes[1] == buffer.laser_id[i] &&
+				   point->extra_bytes[2] == buffer.tag[i] && std::llround(point->gps_time * 1e9) == static_cast<int64_t>(times[i] - base);
+		}
+		else
+		{
+			// epoch seconds in a double keep about 0.25 us
+			same = same && point->user_data == buffer.laser_id[i] && point->classification == buffer.tag[i] &&
+				   std::abs(point->gps_time * 1e9 - static_cast<double>(times[i])) < 1000;
+		}
+		return same;
+	};
+	for(uint64_t p = 0; ok && p < points; p++)
+	{
+		ok = check(p);
+	}
+	const uint64_t middle = points / 2 + 7;
+	ok = ok && !laszip_seek_point(reader, middle);
+	for(uint64_t p = middle; ok && p < std::min(points, middle + LazChunkPoints); p++)
+	{
+		ok = check(p);
+	}
+	laszip_close_reader(reader);
+	laszip_destroy(reader);
+	if(!ok)
+	{
+		std::cerr << "points of " << filename << " differ from the buffer" << std::endl;
+	}
+	return ok;
+}
+
+//! the file as the rest of the tree reads it
+bool verifyLoad(const std::string& filename, const LivoxPointsBuffer& buffer, const std::vector<uint64_t>& times)
+{
+	LivoxPointsBuffer loaded;
+	const size_t step = lazDecimationStep(buffer.size());
+	bool ok = loadLaz(filename, loaded) && loaded.size() == (buffer.size() + step - 1) / step;
+	const auto loadedTimes = timestamps(loaded);
+	for(size_t p = 0; ok && p < loaded.size(); p++)
+	{
+		const size_t i = p * step;
+		ok = loaded.x[p] == buffer.x[i] && loaded.y[p] == buffer.y[i] && loaded.z[p] == buffer.z[i] && loaded.reflectivity[p] == buffer.reflectivity[i] &&
+			 loaded.tag[p] == buffer.tag[i] && loaded.laser_id[p] == buffer.laser_id[i] &&
+			 std::abs(static_cast<int64_t>(loadedTimes[p] - times[i])) < 1000;
+	}
+	if(!ok)
+	{
+		std::cerr << "loadLaz of " << filename << " differs from the buffer" << std::endl;
+	}
+	return ok;
+}
+
+template <typename F>
+double seconds(F&& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	const size_t points = argc > 1 ? std::atol(argv[1]) : 4000000;
+	const unsigned maxThreads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+	const std::string filename = argc > 3 ? argv[3] : "/tmp/laz_benchmark.laz";
+	const LasFormat format = lasFormatFromString(argc > 4 ? argv[4] : "1");
+	const auto buffer = makeBuffer(points);
+	const auto times = timestamps(*buffer);
+	const uint64_t written = (points + lazDecimationStep(points) - 1) / lazDecimationStep(points);
+	const auto valid = [&](bool saved) {
+		return saved && verifyStructure(filename, written, format) && verifyPoints(filename, *buffer, times, format) && verifyLoad(filename, *buffer, times);
+	};
+
+	bool allValid = true;
+	bool saved = false;
+	const double baseline = seconds([&]() { saved = saveLaz(filename, buffer, format); });
+	const bool baselineValid = valid(saved);
+	allValid &= baselineValid;
+	std::cout << "saveLaz        : " << points / baseline / 1e6 << " M points/s, " << (baselineValid ? "valid" : "INVALID") << std::endl;
+	for(unsigned threads = 2; threads <= maxThreads; threads++)
+	{
+		const double parallel = seconds([&]() { saved = saveLazParallel(filename, buffer, threads, format); });
+		const bool parallelValid = valid(saved);
+		allValid &= parallelValid;
+		std::cout << "threads " << threads << (threads < 10 ? "      : " : "     : ") << points / parallel / 1e6 << " M points/s, x" << baseline / parallel << ", "
+				  << (parallelValid ? "valid" : "INVALID") << std::endl;
+	}
+	return allValid ? 0 : 1;
+}
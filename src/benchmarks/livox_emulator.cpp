@@ -0,0 +1,622 @@
+// Emulates MID360 lidars on loopback, to load test LivoxClient through the SDK sockets without hardware.
+// Virtual lidar n owns the address 127.0.0.<10 + n>. It answers enough of the SDK2 command protocol for the SDK
+// to detect and configure it (search, parameter set/get, reboot) and streams point and IMU packets to the host
+// ports of LivoxClient::config, either synthetic or taken from a recording of LivoxPacketRecorder.
+// Start control_program with MANDEYE_LIVOX_LISTEN_IP=127.0.0.1.
+// usage: livox_emulator [lidars] [points/s per lidar, or replay speed with a recording] [seconds, 0 = forever] [recording]
+#include "livox_types.h"
+#include "utils/livox_recording.h"
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <livox_lidar_def.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace mandeye;
+
+namespace
+{
+// ports of LivoxClient::config
+constexpr uint16_t DetectionPort = 56000;
+constexpr uint16_t LidarCommandPort = 56100;
+constexpr uint16_t LidarPointPort = 56300;
+constexpr uint16_t LidarImuPort = 56400;
+constexpr uint16_t HostCommandPort = 56101;
+constexpr uint16_t HostPointPort = 56301;
+constexpr uint16_t HostImuPort = 56401;
+
+constexpr uint8_t Mid360DevType = 9;
+constexpr auto ImuPeriod = std::chrono::microseconds(5000); // 200 Hz
+constexpr auto FramePeriod = std::chrono::milliseconds(100); // frame_cnt rate
+constexpr auto AnnouncePeriod = std::chrono::seconds(1);
+
+// SDK2 command frame
+constexpr uint8_t Sof = 0xAA;
+constexpr uint8_t CommandRequest = 0;
+constexpr uint8_t CommandAck = 1;
+constexpr uint8_t SenderLidar = 1;
+constexpr uint16_t CommandSearch = 0x0000;
+constexpr uint16_t CommandSetParameters = 0x0100;
+constexpr uint16_t CommandGetParameters = 0x0101;
+
+#pragma pack(push, 1)
+struct CommandHeader
+{
+	uint8_t sof;
+	uint8_t version;
+	uint16_t length; // header and data
+	uint16_t seq;
+	uint16_t cmdId;
+	uint8_t cmdType;
+	uint8_t senderType;
+	uint8_t rsvd[6];
+	uint16_t crc16; // of the header bytes before it
+	uint32_t crc32; // of the data
+};
+
+struct SearchAck
+{
+	uint8_t retCode;
+	uint8_t devType;
+	char sn[16];
+	uint8_t lidarIp[4];
+	uint16_t commandPort;
+};
+
+//! value of the host IP keys
+struct HostIpValue
+{
+	uint8_t ip[4];
+	uint16_t hostPort;
+	uint16_t lidarPort;
+};
+#pragma pack(pop)
+
+constexpr size_t PacketHeaderSize = offsetof(LivoxLidarEthernetPacket, data);
+
+//! CRC-16/CCITT-FALSE
+uint16_t crc16(const uint8_t* data, size_t size)
+{
+	uint16_t crc = 0xFFFF;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc ^= static_cast<uint16_t>(data[i]) << 8;
+		for(int b = 0; b < 8; b++)
+		{
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+//! CRC-32 (IEEE 802.3)
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+	static const auto table = []() {
+		std::array<uint32_t, 256> t{};
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for(int b = 0; b < 8; b++)
+			{
+				c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+			}
+			t[i] = c;
+		}
+		return t;
+	}();
+	uint32_t crc = 0xFFFFFFFFu;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+sockaddr_in makeAddress(uint32_t ip, uint16_t port)
+{
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = ip;
+	address.sin_port = htons(port);
+	return address;
+}
+
+int openSocket(uint32_t ip, uint16_t port)
+{
+	const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	const int one = 1;
+	const int sendBuffer = 4 << 20;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+	const sockaddr_in address = makeAddress(ip, port);
+	if(bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		std::cerr << "Cannot bind " << inet_ntoa(address.sin_addr) << ":" << port << ": " << std::strerror(errno) << std::endl;
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+std::atomic<bool> isRunning{true};
+
+struct VirtualLidar
+{
+	uint32_t ip; // network order
+	std::string sn;
+	int detectionFd{-1};
+	int commandFd{-1};
+	int pointFd{-1};
+	int imuFd{-1};
+
+	// set by the command thread, used by the data thread
+	std::atomic<uint32_t> hostIp{htonl(INADDR_LOOPBACK)};
+	std::atomic<uint16_t> hostPointPort{HostPointPort};
+	std::atomic<uint16_t> hostImuPort{HostImuPort};
+	std::atomic<bool> detected{false};
+	uint8_t workMode{kLivoxLidarNormal};
+
+	// data thread private
+	uint16_t pointUdpCnt{0}; // every stream counts its own packets, like the lidar does
+	uint16_t imuUdpCnt{0};
+	uint8_t frameCnt{0};
+	std::chrono::steady_clock::time_point nextFrame{};
+	std::atomic<uint64_t> pointPackets{0};
+	std::atomic<uint64_t> imuPackets{0};
+	std::atomic<uint64_t> sendErrors{0};
+
+	bool open(int index)
+	{
+		ip = htonl((127u << 24) | (10u + index));
+		sn = "EMU" + std::to_string(1000000 + index);
+		detectionFd = openSocket(ip, DetectionPort);
+		commandFd = openSocket(ip, LidarCommandPort);
+		pointFd = openSocket(ip, LidarPointPort);
+		imuFd = openSocket(ip, LidarImuPort);
+		return detectionFd >= 0 && commandFd >= 0 && pointFd >= 0 && imuFd >= 0;
+	}
+
+	void send(int fd, uint32_t toIp, uint16_t toPort, const void* data, size_t size)
+	{
+		const sockaddr_in address = makeAddress(toIp, toPort);
+		if(sendto(fd, data, size, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+		{
+			sendErrors++;
+		}
+	}
+
+	void sendPacket(LivoxLidarEthernetPacket* packet, size_t size, bool imu)
+	{
+		packet->length = static_cast<uint16_t>(size);
+		packet->udp_cnt = imu ? imuUdpCnt++ : pointUdpCnt++;
+		packet->frame_cnt = frameCnt;
+		packet->crc32 = crc32(packet->data, size - PacketHeaderSize);
+		if(imu)
+		{
+			send(imuFd, hostIp, hostImuPort, packet, size);
+			imuPackets++;
+		}
+		else
+		{
+			send(pointFd, hostIp, hostPointPort, packet, size);
+			pointPackets++;
+		}
+	}
+};
+
+void sendCommand(VirtualLidar& lidar, int fd, const sockaddr_in& to, uint16_t seq, uint16_t cmdId, uint8_t cmdType, const uint8_t* data, size_t size)
+{
+	std::vector<uint8_t> frame(sizeof(CommandHeader) + size);
+	auto* header = reinterpret_cast<CommandHeader*>(frame.data());
+	header->sof = Sof;
+	header->version = 0;
+	header->length = static_cast<uint16_t>(frame.size());
+	header->seq = seq;
+	header->cmdId = cmdId;
+	header->cmdType = cmdType;
+	header->senderType = SenderLidar;
+	header->crc16 = crc16(frame.data(), offsetof(CommandHeader, crc16));
+	header->crc32 = crc32(data, size);
+	std::memcpy(frame.data() + sizeof(CommandHeader), data, size);
+	lidar.send(fd, to.sin_addr.s_addr, ntohs(to.sin_port), frame.data(), frame.size());
+}
+
+void sendSearchAck(VirtualLidar& lidar, const sockaddr_in& to, uint16_t seq)
+{
+	SearchAck ack{};
+	ack.retCode = 0;
+	ack.devType = Mid360DevType;
+	std::strncpy(ack.sn, lidar.sn.c_str(), sizeof(ack.sn) - 1);
+	std::memcpy(ack.lidarIp, &lidar.ip, sizeof(ack.lidarIp));
+	ack.commandPort = LidarCommandPort;
+	sendCommand(lidar, lidar.detectionFd, to, seq, CommandSearch, CommandAck, reinterpret_cast<const uint8_t*>(&ack), sizeof(ack));
+}
+
+void appendKey(std::vector<uint8_t>& out, uint16_t key, const void* value, uint16_t size)
+{
+	const size_t offset = out.size();
+	out.resize(offset + 4 + size);
+	std::memcpy(out.data() + offset, &key, 2);
+	std::memcpy(out.data() + offset + 2, &size, 2);
+	std::memcpy(out.data() + offset + 4, value, size);
+}
+
+//! answers one command from the host, unknown commands are acknowledged with success
+void handleCommand(VirtualLidar& lidar, int fd, const uint8_t* frame, size_t size, const sockaddr_in& from)
+{
+	if(size < sizeof(CommandHeader))
+	{
+		return;
+	}
+	CommandHeader header;
+	std::memcpy(&header, frame, sizeof(header));
+	// a length shorter than the header would underflow the data size
+	if(header.sof != Sof || header.cmdType != CommandRequest || header.length < sizeof(CommandHeader) || header.length > size)
+	{
+		return;
+	}
+	const uint8_t* data = frame + sizeof(CommandHeader);
+	const size_t dataSize = header.length - sizeof(CommandHeader);
+	lidar.hostIp = from.sin_addr.s_addr;
+	lidar.detected = true;
+
+	std::vector<uint8_t> ack;
+	switch(header.cmdId)
+	{
+	case CommandSearch:
+		sendSearchAck(lidar, from, header.seq);
+		return;
+	case CommandSetParameters:
+	{
+		// key_num, rsvd, then key, length, value
+		for(size_t off = 4; off + 4 <= dataSize;)
+		{
+			uint16_t key, length;
+			std::memcpy(&key, data + off, 2);
+			std::memcpy(&length, data + off + 2, 2);
+			const uint8_t* value = data + off + 4;
+			if(off + 4 + length > dataSize)
+			{
+				break;
+			}
+			HostIpValue host;
+			if(key == kKeyWorkMode && length >= 1)
+			{
+				lidar.workMode = value[0];
+			}
+			else if((key == kKeyLidarPointDataHostIPCfg || key == kKeyLidarImuHostIPCfg) && length >= sizeof(host))
+			{
+				std::memcpy(&host, value, sizeof(host));
+				uint32_t ip;
+				std::memcpy(&ip, host.ip, sizeof(ip));
+				lidar.hostIp = ip;
+				(key == kKeyLidarPointDataHostIPCfg ? lidar.hostPointPort : lidar.hostImuPort) = host.hostPort;
+			}
+			off += 4 + length;
+		}
+		const uint8_t retCode = 0;
+		const uint16_t errorKey = 0;
+		ack.push_back(retCode);
+		ack.resize(3);
+		std::memcpy(ack.data() + 1, &errorKey, 2);
+		break;
+	}
+	case CommandGetParameters:
+	{
+		// key_num, rsvd, then the requested keys, answered with ret_code, key_num and key, length, value
+		std::vector<uint8_t> values;
+		uint16_t answered = 0;
+		for(size_t off = 4; off + 2 <= dataSize; off += 2)
+		{
+			uint16_t key;
+			std::memcpy(&key, data + off, 2);
+			if(key == kKeyWorkMode)
+			{
+				appendKey(values, key, &lidar.workMode, 1);
+				answered++;
+			}
+			else if(key == kKeyTimeSyncType)
+			{
+				const uint8_t none = 0;
+				appendKey(values, key, &none, 1);
+				answered++;
+			}
+			else if(key == kKeyLidarPointDataHostIPCfg || key == kKeyLidarImuHostIPCfg)
+			{
+				HostIpValue host;
+				const uint32_t ip = lidar.hostIp;
+				std::memcpy(host.ip, &ip, sizeof(host.ip));
+				host.hostPort = key == kKeyLidarPointDataHostIPCfg ? lidar.hostPointPort.load() : lidar.hostImuPort.load();
+				host.lidarPort = key == kKeyLidarPointDataHostIPCfg ? LidarPointPort : LidarImuPort;
+				appendKey(values, key, &host, sizeof(host));
+				answered++;
+			}
+		}
+		ack.resize(3);
+		std::memcpy(ack.data() + 1, &answered, 2);
+		ack.insert(ack.end(), values.begin(), values.end());
+		break;
+	}
+	default:
+		ack.push_back(0); // ret_code success
+		break;
+	}
+	sendCommand(lidar, fd, from, header.seq, header.cmdId, CommandAck, ack.data(), ack.size());
+}
+
+//! answers searches and commands of every lidar, announces lidars the host has not talked to yet
+void commandThread(std::vector<VirtualLidar>& lidars)
+{
+	const int broadcastFd = openSocket(htonl(INADDR_ANY), DetectionPort);
+	std::vector<pollfd> fds;
+	for(auto& lidar : lidars)
+	{
+		fds.push_back({lidar.detectionFd, POLLIN, 0});
+		fds.push_back({lidar.commandFd, POLLIN, 0});
+	}
+	fds.push_back({broadcastFd, POLLIN, 0});
+
+	uint8_t frame[2048];
+	auto nextAnnounce = std::chrono::steady_clock::now();
+	while(isRunning)
+	{
+		if(std::chrono::steady_clock::now() >= nextAnnounce)
+		{
+			// the SDK search is a broadcast that does not reach loopback, so answer it unasked
+			for(auto& lidar : lidars)
+			{
+				if(!lidar.detected)
+				{
+					sendSearchAck(lidar, makeAddress(lidar.hostIp, HostCommandPort), 0);
+				}
+			}
+			nextAnnounce += AnnouncePeriod;
+		}
+		if(poll(fds.data(), fds.size(), 100) <= 0)
+		{
+			continue;
+		}
+		for(size_t i = 0; i < fds.size(); i++)
+		{
+			if(fds[i].fd < 0 || !(fds[i].revents & POLLIN))
+			{
+				continue;
+			}
+			sockaddr_in from{};
+			socklen_t fromSize = sizeof(from);
+			const ssize_t size = recvfrom(fds[i].fd, frame, sizeof(frame), 0, reinterpret_cast<sockaddr*>(&from), &fromSize);
+			if(size <= 0)
+			{
+				continue;
+			}
+			if(fds[i].fd == broadcastFd)
+			{
+				for(auto& lidar : lidars)
+				{
+					handleCommand(lidar, lidar.detectionFd, frame, size, from);
+				}
+			}
+			else
+			{
+				handleCommand(lidars[i / 2], fds[i].fd, frame, size, from);
+			}
+		}
+	}
+	close(broadcastFd);
+}
+
+uint64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//! streams a scan pattern of points on a 5 to 15 m sphere, and IMU at 200 Hz, from every lidar
+void syntheticDataThread(std::vector<VirtualLidar>& lidars, double pointsPerSecond, std::chrono::steady_clock::time_point end)
+{
+	const auto packetPeriod = std::chrono::nanoseconds(static_cast<int64_t>(1e9 * LivoxMaxPointsPerPacket / pointsPerSecond));
+	alignas(8) uint8_t pointBuffer[PacketHeaderSize + LivoxMaxPointsPerPacket * sizeof(LivoxLidarCartesianHighRawPoint)]{};
+	alignas(8) uint8_t imuBuffer[PacketHeaderSize + sizeof(LivoxLidarImuRawPoint)]{};
+	auto* pointPacket = reinterpret_cast<LivoxLidarEthernetPacket*>(pointBuffer);
+	auto* imuPacket = reinterpret_cast<LivoxLidarEthernetPacket*>(imuBuffer);
+	pointPacket->data_type = kLivoxLidarCartesianCoordinateHighData;
+	pointPacket->dot_num = LivoxMaxPointsPerPacket;
+	pointPacket->time_interval = static_cast<uint16_t>(std::min<int64_t>(packetPeriod.count() / LivoxTimeIntervalUnitNs, UINT16_MAX));
+	imuPacket->data_type = kLivoxLidarImuData;
+	imuPacket->dot_num = 1;
+	auto* imu = reinterpret_cast<LivoxLidarImuRawPoint*>(imuPacket->data);
+	imu->acc_z = 1.0f;
+
+	auto* points = reinterpret_cast<LivoxLidarCartesianHighRawPoint*>(pointPacket->data);
+	uint64_t pointIndex = 0;
+	auto nextPoints = std::chrono::steady_clock::now();
+	auto nextImu = nextPoints;
+	for(auto& lidar : lidars)
+	{
+		lidar.nextFrame = nextPoints + FramePeriod;
+	}
+	while(isRunning && std::chrono::steady_clock::now() < end)
+	{
+		const auto due = std::min(nextPoints, nextImu);
+		std::this_thread::sleep_until(due);
+		if(due == nextImu)
+		{
+			const uint64_t timestamp = nowNs();
+			std::memcpy(imuPacket->timestamp, &timestamp, sizeof(timestamp));
+			for(auto& lidar : lidars)
+			{
+				lidar.sendPacket(imuPacket, sizeof(imuBuffer), true);
+			}
+			nextImu += ImuPeriod;
+			continue;
+		}
+		for(uint16_t i = 0; i < LivoxMaxPointsPerPacket; i++, pointIndex++)
+		{
+			// golden angle spiral over the sphere, radius changes slowly
+			const double t = pointIndex * 2.399963;
+			const double z = 1.0 - 2.0 * ((pointIndex % 20000) + 0.5) / 20000;
+			const double r = std::sqrt(1.0 - z * z);
+			const double range = 5000 + 10000 * (0.5 + 0.5 * std::sin(pointIndex * 1e-5));
+			points[i].x = static_cast<int32_t>(range * r * std::cos(t));
+			points[i].y = static_cast<int32_t>(range * r * std::sin(t));
+			points[i].z = static_cast<int32_t>(range * z);
+			points[i].reflectivity = static_cast<uint8_t>(pointIndex);
+			points[i].tag = 0;
+		}
+		const uint64_t timestamp = nowNs();
+		std::memcpy(pointPacket->timestamp, &timestamp, sizeof(timestamp));
+		for(auto& lidar : lidars)
+		{
+			if(due >= lidar.nextFrame)
+			{
+				lidar.frameCnt++;
+				lidar.nextFrame += FramePeriod;
+			}
+			lidar.sendPacket(pointPacket, sizeof(pointBuffer), false);
+		}
+		nextPoints += packetPeriod;
+	}
+}
+
+//! streams a recording, the n-th lidar of the recording is sent by the n-th virtual lidar
+void recordingDataThread(std::vector<VirtualLidar>& lidars, const std::string& path, double speed, std::chrono::steady_clock::time_point end)
+{
+	LivoxRecordingReader reader(path);
+	alignas(8) uint8_t data[LivoxRecordingReader::MaxRecordSize];
+	auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(data);
+	LivoxRecordHeader header;
+	std::unordered_map<uint32_t, size_t> handleToLidar;
+	const auto start = std::chrono::steady_clock::now();
+	uint64_t passStart = 0; // ns from start, passes follow each other
+	uint64_t lastArrival = 0;
+	bool emptyPass = true;
+	while(isRunning && std::chrono::steady_clock::now() < end)
+	{
+		if(!reader.next(header, data))
+		{
+			if(emptyPass)
+			{
+				break;
+			}
+			reader.rewind();
+			passStart += lastArrival;
+			emptyPass = true;
+			continue;
+		}
+		emptyPass = false;
+		lastArrival = header.arrival;
+		if(header.kind == static_cast<uint8_t>(LivoxRecordKind::LidarInfo))
+		{
+			continue; // the emulator announces its own lidars
+		}
+		auto it = handleToLidar.find(header.handle);
+		if(it == handleToLidar.end())
+		{
+			it = handleToLidar.emplace(header.handle, handleToLidar.size()).first;
+		}
+		if(it->second >= lidars.size())
+		{
+			continue;
+		}
+		if(speed > 0)
+		{
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<uint64_t>((passStart + header.arrival) / speed)));
+		}
+		const uint64_t timestamp = nowNs();
+		std::memcpy(packet->timestamp, &timestamp, sizeof(timestamp));
+		auto& lidar = lidars[it->second];
+		if(header.kind == static_cast<uint8_t>(LivoxRecordKind::Imu))
+		{
+			lidar.sendPacket(packet, header.size, true);
+		}
+		else
+		{
+			lidar.frameCnt = packet->frame_cnt;
+			lidar.sendPacket(packet, header.size, false);
+		}
+	}
+}
+
+void stopEmulator(int)
+{
+	isRunning = false;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const int lidarCount = argc > 1 ? std::atoi(argv[1]) : 1;
+	const double rate = argc > 2 ? std::atof(argv[2]) : 200000;
+	const int seconds = argc > 3 ? std::atoi(argv[3]) : 0;
+	const std::string recording = argc > 4 ? argv[4] : "";
+	if(lidarCount < 1 || lidarCount > 200 || (recording.empty() && rate <= 0))
+	{
+		std::cerr << "usage: livox_emulator [lidars] [points/s per lidar, or replay speed with a recording] [seconds, 0 = forever] [recording]" << std::endl;
+		return 1;
+	}
+	signal(SIGINT, stopEmulator);
+
+	std::vector<VirtualLidar> lidars(lidarCount);
+	for(int i = 0; i < lidarCount; i++)
+	{
+		if(!lidars[i].open(i))
+		{
+			return 1;
+		}
+		std::cout << "lidar " << lidars[i].sn << " at 127.0.0." << 10 + i << std::endl;
+	}
+
+	const auto end = seconds > 0 ? std::chrono::steady_clock::now() + std::chrono::seconds(seconds) : std::chrono::steady_clock::time_point::max();
+	std::thread commands(commandThread, std::ref(lidars));
+	std::thread data([&]() {
+		if(recording.empty())
+		{
+			syntheticDataThread(lidars, rate, end);
+		}
+		else
+		{
+			recordingDataThread(lidars, recording, rate, end);
+		}
+		isRunning = false;
+	});
+
+	std::vector<uint64_t> lastPoints(lidarCount, 0);
+	while(isRunning)
+	{
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		for(int i = 0; i < lidarCount; i++)
+		{
+			const uint64_t pointPackets = lidars[i].pointPackets;
+			std::cout << lidars[i].sn << (lidars[i].detected ? " detected" : " waiting") << ": " << (pointPackets - lastPoints[i]) * LivoxMaxPointsPerPacket
+					  << " points/s, " << pointPackets << " point packets, " << lidars[i].imuPackets << " imu packets, " << lidars[i].sendErrors
+					  << " send errors" << std::endl;
+			lastPoints[i] = pointPackets;
+		}
+	}
+	data.join();
+	commands.join();
+	for(auto& lidar : lidars)
+	{
+		close(lidar.detectionFd);
+		close(lidar.commandFd);
+		close(lidar.pointFd);
+		close(lidar.imuFd);
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+// Compares the lock-free SensorClock against the mutex protected clock it replaced,
+// with one writer publishing as fast as it can (packet callback) and several readers (cameras, GNSS).
+// usage: timestamp_benchmark [readers] [milliseconds]
+#include "utils/SensorClock.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! the previous LivoxClient clock
+class MutexClock
+{
+public:
+	void publish(uint64_t systemTimestamp)
+	{
+		std::lock_guard<std::mutex> lck(mutex);
+		timestamp = systemTimestamp;
+	}
+	uint64_t now()
+	{
+		std::lock_guard<std::mutex> lck(mutex);
+		return timestamp;
+	}
+
+private:
+	static constexpr uint64_t Unset = uint64_t(-1);
+	std::mutex mutex;
+	uint64_t timestamp{Unset};
+};
+
+struct Result
+{
+	double writesPerSecond;
+	double readsPerSecond;
+	uint64_t nonMonotonicReads;
+};
+
+template <typename Clock>
+Result run(int readers, int milliseconds)
+{
+	Clock clock;
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> reads{0};
+	std::atomic<uint64_t> nonMonotonic{0};
+	uint64_t writes = 0;
+
+	std::vector<std::thread> threads;
+	for(int r = 0; r < readers; r++)
+	{
+		threads.emplace_back([&]() {
+			uint64_t localReads = 0;
+			uint64_t localNonMonotonic = 0;
+			uint64_t last = 0;
+			while(!done.load(std::memory_order_relaxed))
+			{
+				const uint64_t t = clock.now();
+				if(t != uint64_t(-1))
+				{
+					localNonMonotonic += t < last;
+					last = t;
+				}
+				localReads++;
+			}
+			reads += localReads;
+			nonMonotonic += localNonMonotonic;
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto end = start + std::chrono::milliseconds(milliseconds);
+	// the offset to system time comes from the clock model, fixed here
+	const uint64_t delay = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	uint64_t sensorTimestamp = 1000;
+	while(std::chrono::steady_clock::now() < end)
+	{
+		for(int i = 0; i < 64; i++)
+		{
+			clock.publish(sensorTimestamp + delay);
+			sensorTimestamp += 500000; // 2 kHz packet spacing in sensor time
+			writes++;
+		}
+	}
+	done = true;
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return {writes / seconds, reads / seconds, nonMonotonic.load()};
+}
+
+void print(const char* name, const Result& result)
+{
+	std::cout << name << ": writer " << result.writesPerSecond / 1e6 << " M publishes/s, readers " << result.readsPerSecond / 1e6
+			  << " M reads/s, non monotonic reads " << result.nonMonotonicReads << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const int readers = argc > 1 ? std::atoi(argv[1]) : 3;
+	const int milliseconds = argc > 2 ? std::atoi(argv[2]) : 1000;
+	std::cout << "readers " << readers << ", " << milliseconds << " ms per run" << std::endl;
+	print("mutex     ", run<MutexClock>(readers, milliseconds));
+	print("lock-free ", run<utils::SensorClock>(readers, milliseconds));
+	return 0;
+}
@@ -10,7 +10,7 @@ void TimeStampReceiver::SetTimeStampProvider(std::shared_ptr<TimeStampProvider>
 	m_timeStampProvider = std::move(timeStampProvider);
 }
 
-uint64_t TimeStampReceiver::GetTimeStamp()
+uint64_t TimeStampReceiver::GetTimeStamp() noexcept
 {
 	if (m_timeStampProvider)
 	{
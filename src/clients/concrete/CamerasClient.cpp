@@ -52,26 +52,30 @@ void CamerasClient::initializeVideoCapture(int index) {
 	std::cout << "Initialized camera number " << index << std::endl;
 }
 
-void CamerasClient::saveDumpedChunkToDirectory(const std::filesystem::path& dirName, int chunkNumber)
-{
-	// photos_0001
-	std::string chunkDir = "photos_" + std::string(chunkNumber ? 3 - (int) log10(chunkNumber) : 3, '0') + std::to_string(chunkNumber);
-	std::filesystem::path outDir = dirName / chunkDir;
-	if (!std::filesystem::is_directory(outDir) && !std::filesystem::create_directories(outDir)) {
-		std::cerr << "Error creating directory '" << outDir << "'" << std::endl;
-		return;
-	}
-	for(auto& img: dumpBuffer) {
-		std::filesystem::path finalPath = getFinalFilePath(outDir, img.cameraIndex, img.timestamp);
-		std::filesystem::rename(img.path, finalPath);
-	}
-	dumpBuffer.clear();
-}
-
-void CamerasClient::dumpChunkInternally() {
+DumpedChunk CamerasClient::dumpChunk() {
 	std::lock_guard<std::mutex> lock(bufferMutex);
-	dumpBuffer = savedImagesBuffer;
+	auto dumpBuffer = std::make_shared<std::vector<ImageInfo>>(std::move(savedImagesBuffer));
 	savedImagesBuffer.clear();
+	return [dumpBuffer](const std::filesystem::path& dirName, int chunkNumber) {
+		// photos_0001
+		std::string chunkDir = "photos_" + std::string(chunkNumber ? 3 - (int) log10(chunkNumber) : 3, '0') + std::to_string(chunkNumber);
+		std::filesystem::path outDir = dirName / chunkDir;
+		if (!std::filesystem::is_directory(outDir) && !std::filesystem::create_directories(outDir)) {
+			std::cerr << "Error creating directory '" << outDir << "'" << std::endl;
+			return false;
+		}
+		bool moved = true;
+		for(auto& img: *dumpBuffer) {
+			std::filesystem::path finalPath = getFinalFilePath(outDir, img.cameraIndex, img.timestamp);
+			std::error_code error;
+			std::filesystem::rename(img.path, finalPath, error);
+			if (error) {
+				std::cerr << "Error moving '" << img.path << "' to '" << finalPath << "': " << error.message() << std::endl;
+				moved = false;
+			}
+		}
+		return moved;
+	};
 }
 
 std::vector<StampedImage> CamerasClient::readSyncedImages()
@@ -0,0 +1,189 @@
+#include "clients/concrete/ChunkWriter.h"
+#include "utils/utils.h"
+#include <algorithm>
+#include <execution>
+#include <iostream>
+
+namespace mandeye
+{
+
+ChunkWriter::ChunkWriter(const std::filesystem::path& repository, size_t depth, std::function<void(bool)> busy)
+	: m_depth(std::max<size_t>(depth, 1))
+	, m_busy(std::move(busy))
+	, m_recovery(recoverChunks(repository))
+{
+	if(m_recovery.finished != 0 || m_recovery.quarantined != 0)
+	{
+		std::cout << "Recovered chunks: " << m_recovery.finished << " committed, " << m_recovery.quarantined << " quarantined" << std::endl;
+	}
+	m_thread = std::thread(&ChunkWriter::writerThread, this);
+}
+
+ChunkWriter::~ChunkWriter()
+{
+	finish();
+}
+
+void ChunkWriter::finish()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_done = true;
+	}
+	m_condition.notify_all();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+bool ChunkWriter::reserve(bool wait)
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	if(m_pending >= m_depth)
+	{
+		if(!m_backpressured)
+		{
+			m_backpressured = true;
+			m_backpressureEvents++;
+			std::cerr << "Chunk writer is " << m_pending << " chunks behind, " << (wait ? "waiting" : "extending the chunk") << std::endl;
+		}
+		if(!wait)
+		{
+			return false;
+		}
+		m_condition.wait(lck, [this]() { return m_pending < m_depth; });
+	}
+	m_backpressured = false;
+	m_pending++;
+	return true;
+}
+
+void ChunkWriter::enqueue(std::vector<DumpedChunk> dumps, const std::string& directory, int chunk)
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_queue.push_back({std::move(dumps), directory, chunk, std::chrono::steady_clock::now()});
+	m_condition.notify_all();
+}
+
+size_t ChunkWriter::pending()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	return m_pending;
+}
+
+void ChunkWriter::addCommitListener(CommitListener listener)
+{
+	m_commitListeners.push_back(std::move(listener));
+}
+
+void ChunkWriter::writerThread()
+{
+	std::unique_lock<std::mutex> lck(m_mutex);
+	while(true)
+	{
+		m_condition.wait(lck, [this]() { return m_done || !m_queue.empty(); });
+		if(m_queue.empty())
+		{
+			return; // done, and everything saved
+		}
+		Job job = std::move(m_queue.front());
+		m_queue.pop_front();
+		m_savingChunk = job.chunk;
+		lck.unlock();
+
+		m_busy(true);
+		const auto saveStart = std::chrono::steady_clock::now();
+		const bool staged = beginChunk(job.directory, job.chunk);
+		if(!staged)
+		{
+			std::cerr << "Saving chunk " << job.chunk << " without a journal" << std::endl;
+		}
+		const std::string target = staged ? chunkStagingDirectory(job.directory, job.chunk).string() : job.directory;
+		// parallelize the saving of the chunks
+		std::vector<char> saved(job.dumps.size());
+		std::transform(std::execution::par_unseq, job.dumps.begin(), job.dumps.end(), saved.begin(), [&job, &target](auto& dump) {
+			return dump(target, job.chunk);
+		});
+		job.dumps.clear(); // frees the chunk before the next one is taken
+		const auto syncStart = std::chrono::steady_clock::now();
+		const bool flushed = utils::syncFilesystem(target);
+		const bool complete = flushed && std::all_of(saved.begin(), saved.end(), [](char ok) { return ok; });
+		std::vector<std::filesystem::path> files;
+		bool committed = false;
+		if(staged && complete)
+		{
+			committed = commitChunk(job.directory, job.chunk, files);
+		}
+		if(staged && !committed)
+		{
+			std::cerr << "Chunk " << job.chunk << (complete ? " could not be journaled" : flushed ? " was not saved completely" : " could not be synced") << std::endl;
+			quarantineChunk(job.directory, job.chunk);
+		}
+		else if(!complete)
+		{
+			std::cerr << "Chunk " << job.chunk << " was not saved completely" << std::endl;
+		}
+		if(committed)
+		{
+			for(const auto& listener : m_commitListeners)
+			{
+				listener(files);
+			}
+		}
+		const auto synced = std::chrono::steady_clock::now();
+		const double latency = std::chrono::duration<double>(synced - job.dumped).count();
+		const double saveTime = std::chrono::duration<double>(syncStart - saveStart).count();
+		const double syncTime = std::chrono::duration<double>(synced - syncStart).count();
+		std::cout << "Chunk " << job.chunk << " saved in " << saveTime << " s, synced in " << syncTime << " s" << std::endl;
+
+		lck.lock();
+		m_savingChunk = -1;
+		m_pending--;
+		m_saved += committed || !staged;
+		m_failed += staged && !committed;
+		m_lastLatency = latency;
+		m_maxLatency = std::max(m_maxLatency, latency);
+		m_lastSave = saveTime;
+		m_lastSync = syncTime;
+		m_maxSync = std::max(m_maxSync, syncTime);
+		const bool idle = m_pending == 0;
+		m_condition.notify_all();
+		if(idle)
+		{
+			lck.unlock();
+			m_busy(false);
+			lck.lock();
+		}
+	}
+}
+
+nlohmann::json ChunkWriter::produceStatus()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	nlohmann::json data;
+	data["depth"] = m_depth;
+	data["pending"] = m_pending;
+	data["queued"] = m_queue.size();
+	data["saving_chunk"] = m_savingChunk;
+	data["saved"] = m_saved;
+	data["quarantined"] = m_failed;
+	data["last_latency_ms"] = m_lastLatency * 1e3;
+	data["max_latency_ms"] = m_maxLatency * 1e3;
+	data["last_save_ms"] = m_lastSave * 1e3;
+	data["last_sync_ms"] = m_lastSync * 1e3;
+	data["max_sync_ms"] = m_maxSync * 1e3;
+	data["backpressured"] = m_backpressured;
+	data["backpressure_events"] = m_backpressureEvents;
+	data["recovery"]["sessions"] = m_recovery.sessions;
+	data["recovery"]["committed"] = m_recovery.finished;
+	data["recovery"]["quarantined"] = m_recovery.quarantined;
+	return data;
+}
+
+std::string ChunkWriter::getJsonName()
+{
+	return "chunk_writer";
+}
+
+} // namespace mandeye
@@ -6,8 +6,7 @@
 namespace mandeye
 {
 
-GNSSClient::GNSSClient()
-	: bufferSaver("gnss", "gnss", [](const std::string& in) { return in; }) {}
+GNSSClient::GNSSClient() {}
 
 nlohmann::json GNSSClient::produceStatus()
 {
@@ -138,12 +137,13 @@ std::string GNSSClient::getJsonName()
 	return "gnss";
 }
 
-void GNSSClient::dumpChunkInternally() {
-	bufferSaver.setBuffer(retrieveData());
-}
-
-void GNSSClient::saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) {
-	bufferSaver.saveDumpedChunkToDirectory(directory, chunk);
+DumpedChunk GNSSClient::dumpChunk() {
+	auto lines = std::make_shared<std::deque<std::string>>(retrieveData());
+	return [lines](const std::filesystem::path& directory, int chunk) {
+		IterableToFileSaver<std::deque<std::string>, StringLineFormatter> saver("gnss", "gnss");
+		saver.setBuffer(std::move(*lines));
+		return saver.saveDumpedChunkToDirectory(directory, chunk);
+	};
 }
 
 } // namespace mandeye
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "clients/concrete/LazTranscoder.h"
+#include "utils/chunk_journal.h"
+#include "utils/raw_points.h"
+#include <algorithm>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr auto IdlePoll = std::chrono::seconds(1);
+constexpr int LowestPriority = 19;
+} // namespace
+
+LazTranscoder::LazTranscoder(const std::filesystem::path& repository, std::function<bool()> canRun, unsigned threads, LasFormat format)
+	: m_canRun(std::move(canRun))
+	, m_threads(threads)
+	, m_format(format)
+{
+	std::vector<std::filesystem::path> leftovers;
+	std::error_code error;
+	for(auto it = std::filesystem::recursive_directory_iterator(repository, error); !error && it != std::filesystem::recursive_directory_iterator();
+		it.increment(error))
+	{
+		const std::string name = it->path().filename().string();
+		if(it->is_directory() && (name == QuarantineDirectoryName || name.rfind(".chunk", 0) == 0))
+		{
+			it.disable_recursion_pending(); // partial chunks
+		}
+		else if(it->is_regular_file() && it->path().extension() == RawPointsExtension)
+		{
+			leftovers.push_back(it->path());
+		}
+	}
+	std::sort(leftovers.begin(), leftovers.end());
+	for(const auto& rawFile : leftovers)
+	{
+		enqueue(rawFile);
+	}
+	if(!leftovers.empty())
+	{
+		std::cout << "Found " << leftovers.size() << " raw point files to transcode in " << repository << std::endl;
+	}
+	m_thread = std::thread(&LazTranscoder::transcoderThread, this);
+}
+
+LazTranscoder::~LazTranscoder()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_done = true;
+	}
+	m_condition.notify_one();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void LazTranscoder::enqueue(const std::filesystem::path& rawFile)
+{
+	std::error_code error;
+	const uint64_t bytes = std::filesystem::file_size(rawFile, error);
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_queue.push_back(rawFile);
+	m_queuedBytes += error ? 0 : bytes;
+	m_condition.notify_one();
+}
+
+nlohmann::json LazTranscoder::produceStatus()
+{
+	nlohmann::json data;
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		data["queued"] = m_queue.size() + (m_current.empty() ? 0 : 1);
+		data["queued_bytes"] = m_queuedBytes;
+		data["current"] = m_current.string();
+	}
+	data["transcoded"] = m_transcoded.load(std::memory_order_relaxed);
+	data["failed"] = m_failed.load(std::memory_order_relaxed);
+	data["points"] = m_points.load(std::memory_order_relaxed);
+	data["saved_bytes"] = m_savedBytes.load(std::memory_order_relaxed);
+	return data;
+}
+
+std::string LazTranscoder::getJsonName()
+{
+	return "laz_transcoder";
+}
+
+void LazTranscoder::transcoderThread()
+{
+	// Linux threads have their own nice value, the scanning threads keep theirs
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), LowestPriority);
+
+	std::unique_lock<std::mutex> lck(m_mutex);
+	while(!m_done)
+	{
+		if(m_queue.empty() || !m_canRun())
+		{
+			m_condition.wait_for(lck, IdlePoll);
+			continue;
+		}
+		m_current = m_queue.front();
+		m_queue.pop_front();
+		const std::filesystem::path rawFile = m_current;
+		lck.unlock();
+
+		std::error_code error;
+		const uint64_t bytes = std::filesystem::file_size(rawFile, error);
+		if(transcode(rawFile))
+		{
+			m_transcoded.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			m_failed.fetch_add(1, std::memory_order_relaxed); // the raw file stays for a later run
+		}
+
+		lck.lock();
+		m_current.clear();
+		m_queuedBytes -= std::min<uint64_t>(m_queuedBytes, error ? 0 : bytes);
+	}
+}
+
+bool LazTranscoder::transcode(const std::filesystem::path& rawFile)
+{
+	auto buffer = std::make_shared<LivoxPointsBuffer>();
+	if(!loadRawPoints(rawFile.string(), *buffer))
+	{
+		return false;
+	}
+	std::filesystem::path lazFile = rawFile;
+	lazFile.replace_extension(lazExtension(m_format));
+	std::filesystem::path partialFile = lazFile;
+	partialFile += ".part";
+
+	std::cout << "Transcoding " << rawFile << " to " << lazFile << std::endl;
+	std::error_code error;
+	if(!saveLazParallel(partialFile.string(), buffer, m_threads, m_format))
+	{
+		std::filesystem::remove(partialFile, error);
+		return false;
+	}
+	const uint64_t rawBytes = std::filesystem::file_size(rawFile, error);
+	const uint64_t lazBytes = std::filesystem::file_size(partialFile, error);
+	// the LAZ must be on disk before the raw file goes
+	if(!fsyncPath(partialFile))
+	{
+		std::filesystem::remove(partialFile, error);
+		return false;
+	}
+	std::filesystem::rename(partialFile, lazFile, error);
+	if(error)
+	{
+		std::cerr << "Error renaming " << partialFile << " to " << lazFile << ": " << error.message() << std::endl;
+		return false;
+	}
+	fsyncPath(lazFile.parent_path());
+	std::filesystem::remove(rawFile, error);
+	m_points.fetch_add(buffer->size(), std::memory_order_relaxed);
+	m_savedBytes.fetch_add(rawBytes > lazBytes ? rawBytes - lazBytes : 0, std::memory_order_relaxed);
+	return true;
+}
+
+} // namespace mandeye
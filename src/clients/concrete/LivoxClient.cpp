@@ -1,24 +1,56 @@
 #include "clients/concrete/LivoxClient.h"
+#include "utils/raw_points.h"
 #include <livox_lidar_api.h>
 #include <livox_lidar_def.h>
+#include "utils/chunk_spill.h"
+#include "utils/livox_decode.h"
+#include "utils/livox_recording.h"
 #include "utils/save_laz.h"
 #include "livox_types.h"
 #include <iostream>
 #include <thread>
 #include <fstream>
+#include <iomanip>
+#include <charconv>
+#include <cstring>
 
 namespace mandeye
 {
 
-LivoxClient::LivoxClient() : imuIteratorToFileSaver("csv", "imu", [](const LivoxIMU& imu) {
-	std::stringstream ss;
-	ss << imu.timestamp << " " << imu.point.gyro_x << " " << imu.point.gyro_y << " " << imu.point.gyro_z << " " << imu.point.acc_x << " "
-	   << imu.point.acc_y << " " << imu.point.acc_z << " " << imu.laser_id;
-	return ss.str();
-}), lidarIteratorToFileSaver("lidar", "ls", [](const std::pair<const uint32_t, std::string>& id_sn) {
-	return std::to_string(id_sn.first) + " " + id_sn.second;
-}) {
-	m_timestamp = -1;
+LivoxClient::LivoxClient(const LivoxClientConfig& config)
+	: m_deferExpansion(config.deferExpansion), m_lazThreads(config.lazThreads), m_lasFormat(config.lasFormat), m_binaryImu(config.binaryImu), m_pointFilter(config.pointFilter), m_voxelGridConfig(config.voxelGrid), m_voxelGrid(config.voxelGrid), m_memoryBudget(config.memoryBudget) {
+	m_lidarIdTables.push_back(std::make_unique<LidarIdTable>());
+	m_lidarIdTable.store(m_lidarIdTables.back().get(), std::memory_order_release);
+	if(config.streamLaz && config.deferExpansion)
+	{
+		std::cerr << "Streaming LAZ needs expanded points, disabled with deferred expansion" << std::endl;
+	}
+	else if(config.streamLaz)
+	{
+		m_lazStream = std::make_unique<LazStream>(config.memoryBudget.spillDirectory, config.lasFormat);
+	}
+}
+
+LivoxClient::~LivoxClient()
+{
+	isDone = true;
+	if(init_succes)
+	{
+		LivoxLidarSdkUninit();
+	}
+	if(m_livoxWatchThread.joinable())
+	{
+		m_livoxWatchThread.join();
+	}
+	if(m_ingestThread.joinable())
+	{
+		m_ingestThread.join();
+	}
+	m_sealedCondition.notify_all();
+	if(m_spillThread.joinable())
+	{
+		m_spillThread.join();
+	}
 }
 
 std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
@@ -61,38 +93,78 @@ nlohmann::json LivoxClient::produceStatus()
 		data["LivoxLidarInfo"]["lidar_ip"] = "null";
 		data["LivoxLidarInfo"]["sn"] = "null";
 	}
-	if (!m_recivedImuMsgs.empty())
+	auto arrayImu = nlohmann::json::array();
+	auto arrayLidar = nlohmann::json::array();
+	auto arrayStats = nlohmann::json::array();
+	for (auto& slot : m_lidarSlots)
 	{
-		data["counters"]["imu"] = m_recivedImuMsgs.begin()->second;
-		auto array = nlohmann::json::array();
-		for (auto& it : m_recivedImuMsgs)
+		const uint32_t handle = slot.handle.load(std::memory_order_acquire);
+		if (handle == FreeSlot)
 		{
-			array.push_back(it.second);
+			break;
 		}
-		data["multi"]["imu"] = array;
+		const auto& stats = slot.stats;
+		arrayImu.push_back(stats.imuPackets.load(std::memory_order_relaxed));
+		arrayLidar.push_back(stats.pointPackets.load(std::memory_order_relaxed));
+
+		nlohmann::json lidarStats;
+		lidarStats["handle"] = handle;
+		lidarStats["lidar_id"] = handleToLidarId(handle);
+		lidarStats["point_packets"] = stats.pointPackets.load(std::memory_order_relaxed);
+		lidarStats["points"] = stats.points.load(std::memory_order_relaxed);
+		lidarStats["bytes"] = stats.bytes.load(std::memory_order_relaxed);
+		lidarStats["zero_range_points"] = stats.zeroRangePoints.load(std::memory_order_relaxed);
+		lidarStats["timestamp_gaps"] = stats.timestampGaps.load(std::memory_order_relaxed);
+		lidarStats["out_of_order_packets"] = stats.outOfOrderPackets.load(std::memory_order_relaxed);
+		lidarStats["lost_packets"] = stats.lostPackets.load(std::memory_order_relaxed);
+		lidarStats["reordered_packets"] = stats.reorderedPackets.load(std::memory_order_relaxed);
+		lidarStats["lost_frames"] = stats.lostFrames.load(std::memory_order_relaxed);
+		lidarStats["imu_packets"] = stats.imuPackets.load(std::memory_order_relaxed);
+		lidarStats["point_packets_per_second"] = stats.pointPacketsPerSecond.load(std::memory_order_relaxed);
+		lidarStats["points_per_second"] = stats.pointsPerSecond.load(std::memory_order_relaxed);
+		lidarStats["imu_packets_per_second"] = stats.imuPacketsPerSecond.load(std::memory_order_relaxed);
+		lidarStats["clock"] = clockModelToJson(slot.clock);
+		arrayStats.push_back(lidarStats);
 	}
-	else
+	data["counters"]["imu"] = arrayImu.empty() ? nlohmann::json(0) : arrayImu.front();
+	data["counters"]["lidar"] = arrayLidar.empty() ? nlohmann::json(0) : arrayLidar.front();
+	if (!arrayImu.empty())
 	{
-		data["counters"]["imu"] = 0;
+		data["multi"]["imu"] = arrayImu;
+		data["multi"]["lidar"] = arrayLidar;
 	}
-	if(!m_recivedPointMessages.empty())
+	data["stats"] = arrayStats;
+
+	data["filter"] = pointFilterConfigToJson(m_pointFilter);
+	data["filter"]["points"] = m_filterStats.points.load(std::memory_order_relaxed);
+	data["filter"]["rejected"] = m_filterStats.rejected.load(std::memory_order_relaxed);
+	data["filter"]["rejected_by"]["range"] = m_filterStats.range.load(std::memory_order_relaxed);
+	data["filter"]["rejected_by"]["box"] = m_filterStats.box.load(std::memory_order_relaxed);
+	data["filter"]["rejected_by"]["tag"] = m_filterStats.tag.load(std::memory_order_relaxed);
+	data["filter"]["rejected_by"]["reflectivity"] = m_filterStats.reflectivity.load(std::memory_order_relaxed);
+	data["voxel_grid"]["leaf_size"] = m_voxelGridConfig.leafSize / 1000.0;
+	data["voxel_grid"]["points_per_voxel"] = m_voxelGridConfig.pointsPerVoxel;
+	data["voxel_grid"]["dropped_points"] = m_voxelDroppedPoints.load(std::memory_order_relaxed);
+	data["buffers"]["memory"]["bytes"] = m_bufferMemory.load(std::memory_order_relaxed);
+	data["buffers"]["memory"]["budget"] = m_memoryBudget.bytes;
 	{
-		data["counters"]["lidar"] = m_recivedPointMessages.begin()->second;
-		auto array = nlohmann::json::array();
-		for (auto& it : m_recivedPointMessages)
-		{
-			array.push_back(it.second);
-		}
-		data["multi"]["lidar"] = array;
+		std::lock_guard<std::mutex> lck(m_sealedMutex);
+		data["buffers"]["memory"]["sealed_segments"] = m_sealedSegments.size();
 	}
-	else
+	data["buffers"]["memory"]["spill_failed"] = m_spillFailed.load();
+	if(m_recorder)
+	{
+		data["recorder"]["records"] = m_recorder->records();
+		data["recorder"]["dropped"] = m_recorder->dropped();
+	}
+	if(m_lazStream)
 	{
-		data["counters"]["lidar"] = 0;
+		data["laz_stream"]["queued_points"] = m_lazStream->queuedPoints();
 	}
 
 	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
 	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
-	data["LivoxLidarInfo"]["timestamp"] = m_timestamp;
+	data["LivoxLidarInfo"]["timestamp"] = m_clock.now();
 
 
 	auto arrayworkMode = nlohmann::json::array();
@@ -121,11 +193,28 @@ nlohmann::json LivoxClient::produceStatus()
 	data["multi"]["timesyncmode"] = arrayTimeSync;
 
 	auto array = nlohmann::json::array();
-	for (auto& timestamp : m_handleToLastTimestamp)
+	auto arrayRings = nlohmann::json::array();
+	for (auto& slot : m_lidarSlots)
 	{
-		array.push_back(timestamp.second);
+		const uint32_t handle = slot.handle.load(std::memory_order_acquire);
+		if (handle == FreeSlot)
+		{
+			break;
+		}
+		array.push_back(slot.lastTimestamp.load(std::memory_order_relaxed));
+
+		nlohmann::json ring;
+		ring["handle"] = handle;
+		ring["point"]["fill"] = slot.points.size();
+		ring["point"]["capacity"] = slot.points.capacity();
+		ring["point"]["overruns"] = slot.pointsOverruns.load(std::memory_order_relaxed);
+		ring["imu"]["fill"] = slot.imu.size();
+		ring["imu"]["capacity"] = slot.imu.capacity();
+		ring["imu"]["overruns"] = slot.imuOverruns.load(std::memory_order_relaxed);
+		arrayRings.push_back(ring);
 	}
 	data["multi"]["timestamps"] = array;
+	data["rings"] = arrayRings;
 
 
 	auto arraysn = nlohmann::json::array();
@@ -138,11 +227,20 @@ nlohmann::json LivoxClient::produceStatus()
 	if(m_bufferLivoxPtr)
 	{
 		data["buffers"]["point"]["counter"] = m_bufferLivoxPtr->size();
+		data["buffers"]["point"]["bytes"] = m_bufferLivoxPtr->memoryUsage();
 	}
 	else
 	{
 		data["buffers"]["point"]["counter"] = "NULL";
 	}
+	if(m_bufferPacketsPtr)
+	{
+		data["buffers"]["packets"]["counter"] = m_bufferPacketsPtr->size();
+	}
+	else
+	{
+		data["buffers"]["packets"]["counter"] = "NULL";
+	}
 	if(m_bufferIMUPtr)
 	{
 		data["buffers"]["IMU"]["counter"] = m_bufferIMUPtr->size();
@@ -154,40 +252,94 @@ nlohmann::json LivoxClient::produceStatus()
 	return data;
 }
 
-void LivoxClient::setTimestamp(uint64_t ts, LivoxClient* this_ptr)
-{
-	std::lock_guard<std::mutex> lcK(this_ptr->m_timestampMutex);
-	if (this_ptr->m_timestamp == -1) {
-		this_ptr->systemTimestampDelay = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - ts;
-	}
-	this_ptr->m_timestamp = ts + this_ptr->systemTimestampDelay;
-}
-
 void LivoxClient::startLog()
 {
+	{
+		// renumber lidars by serial number once, ids are then frozen until stopLog
+		std::lock_guard<std::mutex> lcK(m_lidarInfoMutex);
+		rebuildLidarIdTable(false);
+		m_sessionActive = true;
+	}
 	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
 	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
 	m_bufferLivoxPtr = std::make_shared<LivoxPointsBuffer>();
+	m_voxelGrid.clear();
+	if(m_deferExpansion)
+	{
+		m_bufferPacketsPtr = std::make_shared<LivoxPacketsBuffer>();
+		m_bufferPacketsPtr->reserve(m_lastChunkPackets);
+	}
 	m_bufferIMUPtr = std::make_shared<LivoxIMUBuffer>();
 }
 
 void LivoxClient::stopLog()
 {
+	{
+		std::lock_guard<std::mutex> lcK(m_lidarInfoMutex);
+		m_sessionActive = false;
+	}
+	std::lock_guard<std::mutex> lckSpill(m_spillFileMutex);
 	std::lock_guard<std::mutex> lcK1(m_bufferLidarMutex);
 	std::lock_guard<std::mutex> lcK2(m_bufferImuMutex);
 	m_bufferLivoxPtr = nullptr;
+	m_bufferPacketsPtr = nullptr;
 	m_bufferIMUPtr = nullptr;
+	{
+		std::lock_guard<std::mutex> lck(m_sealedMutex);
+		m_sealedSegments.clear();
+		m_sealedMemory = 0;
+	}
+	m_spillFile = nullptr;
+	m_spillFailed = false;
+	m_bufferMemory = 0;
+	if(m_lazStream)
+	{
+		m_lazStream->discard(); // blocks streamed since the last chunk do not belong to the next session
+	}
 }
 
-std::pair<LivoxPointsBufferPtr, LivoxIMUBufferPtr> LivoxClient::retrieveData()
+LivoxChunk LivoxClient::retrieveData()
 {
+	drainRings(); // flush what the SDK delivered so far into the current chunk
+	std::lock_guard<std::mutex> lckSpill(m_spillFileMutex);
 	std::lock_guard<std::mutex> lck1(m_bufferLidarMutex);
 	std::lock_guard<std::mutex> lck2(m_bufferImuMutex);
-	LivoxPointsBufferPtr returnPointerLidar{std::make_shared<LivoxPointsBuffer>()};
-	LivoxIMUBufferPtr returnPointerImu{std::make_shared<LivoxIMUBuffer>()};
-	std::swap(m_bufferIMUPtr, returnPointerImu);
-	std::swap(m_bufferLivoxPtr, returnPointerLidar);
-	return std::pair{returnPointerLidar, returnPointerImu};
+	LivoxChunk chunk{std::make_shared<LivoxPointsBuffer>(), nullptr, std::make_shared<LivoxIMUBuffer>()};
+	if(m_bufferLivoxPtr && !m_deferExpansion)
+	{
+		// next chunk is likely as big as this one, avoid regrowing the columns
+		chunk.points->reserve(m_bufferLivoxPtr->size(), m_bufferLivoxPtr->packets());
+	}
+	if(m_deferExpansion)
+	{
+		chunk.packets = std::make_shared<LivoxPacketsBuffer>();
+		if(m_bufferPacketsPtr)
+		{
+			m_lastChunkPackets = m_bufferPacketsPtr->size();
+			chunk.packets->reserve(m_lastChunkPackets);
+		}
+		std::swap(m_bufferPacketsPtr, chunk.packets);
+	}
+	std::swap(m_bufferIMUPtr, chunk.imu);
+	std::swap(m_bufferLivoxPtr, chunk.points);
+	m_voxelGrid.clear(); // one set of points per voxel and chunk
+	{
+		std::lock_guard<std::mutex> lck(m_sealedMutex);
+		chunk.sealed.assign(m_sealedSegments.begin(), m_sealedSegments.end());
+		m_sealedSegments.clear();
+		m_sealedMemory = 0;
+	}
+	chunk.spill = std::move(m_spillFile);
+	m_spillFile = nullptr;
+	m_spillFailed = false;
+	if(m_lazStream)
+	{
+		// the last block closes the file of the chunk, compression of the earlier ones is already done or underway
+		m_lazStream->push(std::move(chunk.points));
+		chunk.points = std::make_shared<LivoxPointsBuffer>();
+		chunk.stream = m_lazStream->rotate();
+	}
+	return chunk;
 }
 void LivoxClient::testThread()
 {
@@ -196,7 +348,11 @@ void LivoxClient::testThread()
 	while(!isDone)
 	{
 		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-
+		sampleRates();
+		if(!init_succes)
+		{
+			continue; // replaying, there is no SDK to query
+		}
 
 		std::lock_guard<std::mutex> lcK(this->m_lidarInfoMutex);
 		for (auto& it : this->m_handleToSerialNumber)
@@ -217,6 +373,399 @@ void LivoxClient::testThread()
 
 	}
 }
+
+void LivoxClient::sampleRates()
+{
+	const auto now = std::chrono::steady_clock::now();
+	for(auto& slot : m_lidarSlots)
+	{
+		if(slot.handle.load(std::memory_order_acquire) == FreeSlot)
+		{
+			break;
+		}
+		auto& stats = slot.stats;
+		const uint64_t pointPackets = stats.pointPackets.load(std::memory_order_relaxed);
+		const uint64_t points = stats.points.load(std::memory_order_relaxed);
+		const uint64_t imuPackets = stats.imuPackets.load(std::memory_order_relaxed);
+		if(stats.sampledAt != std::chrono::steady_clock::time_point{})
+		{
+			const double dt = std::chrono::duration<double>(now - stats.sampledAt).count();
+			stats.pointPacketsPerSecond.store((pointPackets - stats.sampledPointPackets) / dt, std::memory_order_relaxed);
+			stats.pointsPerSecond.store((points - stats.sampledPoints) / dt, std::memory_order_relaxed);
+			stats.imuPacketsPerSecond.store((imuPackets - stats.sampledImuPackets) / dt, std::memory_order_relaxed);
+		}
+		stats.sampledPointPackets = pointPackets;
+		stats.sampledPoints = points;
+		stats.sampledImuPackets = imuPackets;
+		stats.sampledAt = now;
+	}
+}
+
+void LivoxClient::updatePointStats(LidarStats& stats, const LivoxLidarEthernetPacket* data, uint64_t timestamp)
+{
+	const uint16_t dotNum = std::min(data->dot_num, LivoxMaxPointsPerPacket);
+	bump(stats.pointPackets);
+	bump(stats.points, dotNum);
+	bump(stats.bytes, data->length);
+
+	if(data->data_type == kLivoxLidarCartesianCoordinateHighData)
+	{
+		const auto* p_point_data = reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(data->data);
+		uint64_t zeroRange = 0;
+		for(uint16_t i = 0; i < dotNum; i++)
+		{
+			zeroRange += (p_point_data[i].x == 0 && p_point_data[i].y == 0 && p_point_data[i].z == 0);
+		}
+		bump(stats.zeroRangePoints, zeroRange);
+	}
+
+	updateSequenceStats(stats, data, timestamp);
+
+	// a gap is a spacing bigger than twice the running average spacing of the packets
+	if(stats.lastPacketTimestamp != 0)
+	{
+		if(timestamp < stats.lastPacketTimestamp)
+		{
+			bump(stats.outOfOrderPackets);
+			return; // keep the newest timestamp as reference
+		}
+		const uint64_t delta = timestamp - stats.lastPacketTimestamp;
+		if(stats.packetPeriod != 0 && delta > 2 * stats.packetPeriod)
+		{
+			bump(stats.timestampGaps);
+		}
+		else
+		{
+			stats.packetPeriod = stats.packetPeriod == 0 ? delta : (stats.packetPeriod * 15 + delta) / 16;
+		}
+	}
+	stats.lastPacketTimestamp = timestamp;
+}
+
+void LivoxClient::updateSequenceStats(LidarStats& stats, const LivoxLidarEthernetPacket* data, uint64_t timestamp)
+{
+	if(!stats.hasSequence)
+	{
+		stats.hasSequence = true;
+		stats.lastUdpCnt = data->udp_cnt;
+		stats.lastFrameCnt = data->frame_cnt;
+		return;
+	}
+
+	const uint16_t expectedUdpCnt = stats.lastUdpCnt + 1;
+	if(data->frame_cnt == stats.lastFrameCnt || data->udp_cnt == expectedUdpCnt)
+	{
+		// wrapping difference, the upper half of the range means the packet is older than the last one
+		const uint16_t skipped = data->udp_cnt - expectedUdpCnt;
+		if(skipped >= 0x8000)
+		{
+			bump(stats.reorderedPackets);
+			return;
+		}
+		bump(stats.lostPackets, skipped);
+	}
+	else
+	{
+		const uint8_t skippedFrames = data->frame_cnt - stats.lastFrameCnt - 1;
+		if(skippedFrames >= 0x80)
+		{
+			bump(stats.reorderedPackets);
+			return;
+		}
+		bump(stats.lostFrames, skippedFrames);
+
+		// udp_cnt restarted with the new frame, predict the packets missing at the boundary from the packet time span
+		const uint64_t span = data->time_interval * LivoxTimeIntervalUnitNs;
+		if(span != 0 && stats.lastPacketTimestamp != 0 && timestamp > stats.lastPacketTimestamp)
+		{
+			const uint64_t packetsElapsed = (timestamp - stats.lastPacketTimestamp + span / 2) / span;
+			bump(stats.lostPackets, packetsElapsed > 1 ? packetsElapsed - 1 : 0);
+		}
+	}
+	stats.lastUdpCnt = data->udp_cnt;
+	stats.lastFrameCnt = data->frame_cnt;
+}
+
+void LivoxClient::ingestThread()
+{
+	while(!isDone)
+	{
+		if(drainRings() == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+size_t LivoxClient::drainRings()
+{
+	std::lock_guard<std::mutex> lck(m_ingestMutex);
+	size_t consumed = 0;
+	size_t imuMemory = 0;
+	for(auto& slot : m_lidarSlots)
+	{
+		if(slot.handle.load(std::memory_order_acquire) == FreeSlot)
+		{
+			break;
+		}
+		{
+			std::lock_guard<std::mutex> lcK(m_bufferLidarMutex);
+			consumed += slot.points.consumeAll([this](const LivoxPointsPacket& packet) {
+				if(m_bufferPacketsPtr)
+				{
+					m_bufferPacketsPtr->append() = packet; // expanded when the chunk is saved
+				}
+				else if(m_bufferLivoxPtr)
+				{
+					appendPacket(packet, *m_bufferLivoxPtr, m_voxelGrid);
+				}
+			});
+		}
+		{
+			std::lock_guard<std::mutex> lcK(m_bufferImuMutex);
+			consumed += slot.imu.consumeAll([this](const LivoxIMU& imu) {
+				if(m_bufferIMUPtr)
+				{
+					m_bufferIMUPtr->push_back(imu);
+				}
+			});
+			imuMemory = m_bufferIMUPtr ? m_bufferIMUPtr->size() * sizeof(LivoxIMU) : 0;
+		}
+	}
+	if(consumed != 0)
+	{
+		std::lock_guard<std::mutex> lcK(m_bufferLidarMutex);
+		streamBlockIfFull();
+		sealSegmentIfOverBudget(imuMemory);
+	}
+	return consumed;
+}
+
+void LivoxClient::streamBlockIfFull()
+{
+	if(!m_lazStream || !m_bufferLivoxPtr || m_bufferLivoxPtr->size() < LazChunkPoints)
+	{
+		return;
+	}
+	auto block = std::make_shared<LivoxPointsBuffer>();
+	block->reserve(m_bufferLivoxPtr->size() + LivoxMaxPointsPerPacket, m_bufferLivoxPtr->packets() + 1);
+	std::swap(block, m_bufferLivoxPtr);
+	m_lazStream->push(std::move(block));
+}
+
+void LivoxClient::sealSegmentIfOverBudget(size_t imuMemory)
+{
+	const size_t segmentMemory = (m_bufferLivoxPtr ? m_bufferLivoxPtr->memoryUsage() : 0) + (m_bufferPacketsPtr ? m_bufferPacketsPtr->memoryUsage() : 0);
+	size_t sealedMemory;
+	{
+		std::lock_guard<std::mutex> lck(m_sealedMutex);
+		sealedMemory = m_sealedMemory;
+	}
+	m_bufferMemory.store(segmentMemory + sealedMemory + imuMemory, std::memory_order_relaxed);
+	// a streamed chunk is already bounded by the stream blocks, and its file is closed without the sealed segments
+	if(m_lazStream || m_memoryBudget.bytes == 0 || segmentMemory < m_memoryBudget.bytes / 2)
+	{
+		return;
+	}
+
+	LivoxSegment segment;
+	if(m_deferExpansion)
+	{
+		segment.packets = std::make_shared<LivoxPacketsBuffer>();
+		std::swap(segment.packets, m_bufferPacketsPtr);
+	}
+	else
+	{
+		segment.points = std::make_shared<LivoxPointsBuffer>();
+		std::swap(segment.points, m_bufferLivoxPtr);
+	}
+	std::lock_guard<std::mutex> lck(m_sealedMutex);
+	m_sealedMemory += segment.memoryUsage();
+	m_sealedSegments.push_back(std::move(segment));
+	m_sealedCondition.notify_one();
+}
+
+void LivoxClient::spillThread()
+{
+	while(!isDone)
+	{
+		{
+			std::unique_lock<std::mutex> lck(m_sealedMutex);
+			m_sealedCondition.wait_for(lck, std::chrono::seconds(1), [this]() { return isDone || (!m_spillFailed && !m_sealedSegments.empty()); });
+		}
+		// the file lock keeps retrieveData from taking the chunk while one of its segments is being written
+		std::lock_guard<std::mutex> fileLck(m_spillFileMutex);
+		LivoxSegment segment;
+		{
+			std::lock_guard<std::mutex> lck(m_sealedMutex);
+			if(m_spillFailed || m_sealedSegments.empty())
+			{
+				continue;
+			}
+			segment = m_sealedSegments.front(); // stays queued until written, so it is never lost
+		}
+		if(!m_spillFile)
+		{
+			const std::string name = "livox_spill_" + std::to_string(m_spillFiles++) + ".bin";
+			m_spillFile = std::make_shared<ChunkSpillFile>(m_memoryBudget.spillDirectory / name);
+		}
+		const bool written = segment.points ? m_spillFile->write(*segment.points) : m_spillFile->write(*segment.packets);
+		if(!written)
+		{
+			std::cerr << "Spilling Livox segment failed, keeping the rest of the chunk in memory" << std::endl;
+			m_spillFailed = true;
+			continue;
+		}
+		std::lock_guard<std::mutex> lck(m_sealedMutex);
+		m_sealedMemory -= segment.memoryUsage();
+		m_sealedSegments.pop_front();
+	}
+}
+
+void LivoxClient::appendPacket(const LivoxPointsPacket& packet, LivoxPointsBuffer& buffer, VoxelDownsampler& voxels)
+{
+	if(packet.timestamp == 0)
+	{
+		return; // no clock yet
+	}
+	DecodedPoints points;
+	const size_t count = decodeLivoxPoints(packet.data_type, packet.payload, packet.dot_num, points);
+	buffer.beginPacket(packet.timestamp);
+	if(!m_pointFilter.enabled && !voxels.enabled())
+	{
+		for(uint32_t i = 0; i < count; i++)
+		{
+			buffer.push(points.x[i], points.y[i], points.z[i], points.reflectivity[i], points.tag[i], i % LivoxMid360Lines, packet.laser_id, livoxPointTimeOffset(packet.time_interval, i, packet.dot_num));
+		}
+		return;
+	}
+
+	uint8_t keep[LivoxMaxPointsPerPacket];
+	if(m_pointFilter.enabled)
+	{
+		PointFilterCounters counters;
+		filterPoints(m_pointFilter, points, count, keep, counters);
+		m_filterStats.points.fetch_add(count, std::memory_order_relaxed);
+		m_filterStats.range.fetch_add(counters.range, std::memory_order_relaxed);
+		m_filterStats.box.fetch_add(counters.box, std::memory_order_relaxed);
+		m_filterStats.tag.fetch_add(counters.tag, std::memory_order_relaxed);
+		m_filterStats.reflectivity.fetch_add(counters.reflectivity, std::memory_order_relaxed);
+		m_filterStats.rejected.fetch_add(counters.rejected, std::memory_order_relaxed);
+	}
+	else
+	{
+		std::fill(keep, keep + count, 1);
+	}
+
+	uint64_t voxelDropped = 0;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if(!keep[i])
+		{
+			continue;
+		}
+		if(!voxels.accept(points.x[i], points.y[i], points.z[i]))
+		{
+			voxelDropped++;
+			continue;
+		}
+		// offset of the original index, kept points keep their exact time
+		buffer.push(points.x[i], points.y[i], points.z[i], points.reflectivity[i], points.tag[i], i % LivoxMid360Lines, packet.laser_id, livoxPointTimeOffset(packet.time_interval, i, packet.dot_num));
+	}
+	m_voxelDroppedPoints.fetch_add(voxelDropped, std::memory_order_relaxed);
+}
+
+LivoxClient::LidarSlot* LivoxClient::handleToSlot(uint32_t handle, uint16_t& lidarId)
+{
+	const auto* entry = m_lidarIdTable.load(std::memory_order_acquire)->find(handle);
+	if(entry != nullptr)
+	{
+		lidarId = entry->lidarId;
+		return entry->slot;
+	}
+	// data arrived before LidarInfoChangeCallback
+	lidarId = UnknownLidarId;
+	return claimSlot(handle);
+}
+
+LivoxClient::LidarSlot* LivoxClient::claimSlot(uint32_t handle)
+{
+	for(auto& slot : m_lidarSlots)
+	{
+		uint32_t current = slot.handle.load(std::memory_order_acquire);
+		if(current == handle)
+		{
+			return &slot;
+		}
+		if(current == FreeSlot)
+		{
+			// point and IMU callbacks may race to claim the slot of a new lidar
+			if(slot.handle.compare_exchange_strong(current, handle, std::memory_order_acq_rel) || current == handle)
+			{
+				return &slot;
+			}
+		}
+	}
+	return nullptr;
+}
+
+const LivoxClient::LidarIdTable::Entry* LivoxClient::LidarIdTable::find(uint32_t handle) const
+{
+	for(size_t i = bucket(handle), probes = 0; probes < Buckets; i = (i + 1) & (Buckets - 1), probes++)
+	{
+		if(entries[i].handle == handle)
+		{
+			return &entries[i];
+		}
+		if(entries[i].handle == FreeSlot)
+		{
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
+
+void LivoxClient::LidarIdTable::insert(uint32_t handle, uint16_t lidarId, LidarSlot* slot)
+{
+	for(size_t i = bucket(handle), probes = 0; probes < Buckets; i = (i + 1) & (Buckets - 1), probes++)
+	{
+		if(entries[i].handle == FreeSlot || entries[i].handle == handle)
+		{
+			entries[i] = Entry{handle, lidarId, slot};
+			return;
+		}
+	}
+}
+
+void LivoxClient::rebuildLidarIdTable(bool keepIds)
+{
+	if(!keepIds)
+	{
+		m_serialNumberToLidarId.clear();
+	}
+	uint16_t nextId = 0;
+	for(const auto& [sn, id] : m_serialNumberToLidarId)
+	{
+		nextId = std::max<uint16_t>(nextId, id + 1);
+	}
+	// set is ordered, so without frozen ids the smallest serial number gets id zero
+	for(const auto& sn : m_serialNumbers)
+	{
+		if(m_serialNumberToLidarId.find(sn) == m_serialNumberToLidarId.end())
+		{
+			m_serialNumberToLidarId[sn] = nextId++;
+		}
+	}
+
+	auto table = std::make_unique<LidarIdTable>();
+	for(const auto& [handle, sn] : m_handleToSerialNumber)
+	{
+		table->insert(handle, m_serialNumberToLidarId.at(sn), claimSlot(handle));
+	}
+	m_lidarIdTable.store(table.get(), std::memory_order_release);
+	m_lidarIdTables.push_back(std::move(table));
+}
+
 bool LivoxClient::startListener(const std::string& interfaceIp)
 {
 	constexpr char configFn[] = "/tmp/config.json";
@@ -236,11 +785,36 @@ bool LivoxClient::startListener(const std::string& interfaceIp)
 	SetLivoxLidarPointCloudCallBack(PointCloudCallback, (void*)this);
 	SetLivoxLidarImuDataCallback(ImuDataCallback, (void*)this);
 	SetLivoxLidarInfoChangeCallback(LidarInfoChangeCallback, (void*)this);
+	startThreads();
+	return true;
+}
 
-	m_livoxWatchThread = std::thread(&LivoxClient::testThread, this);
+bool LivoxClient::startReplay()
+{
+	startThreads();
 	return true;
 }
 
+void LivoxClient::setRecorder(std::shared_ptr<LivoxPacketRecorder> recorder)
+{
+	m_recorder = std::move(recorder);
+}
+
+void LivoxClient::setTranscoder(std::shared_ptr<LazTranscoder> transcoder)
+{
+	m_transcoder = std::move(transcoder);
+}
+
+void LivoxClient::startThreads()
+{
+	m_livoxWatchThread = std::thread(&LivoxClient::testThread, this);
+	m_ingestThread = std::thread(&LivoxClient::ingestThread, this);
+	if(m_memoryBudget.bytes != 0 && !m_lazStream)
+	{
+		m_spillThread = std::thread(&LivoxClient::spillThread, this);
+	}
+}
+
 union ToUint64
 {
 	uint64_t data;
@@ -258,47 +832,50 @@ void LivoxClient::PointCloudCallback(uint32_t handle,
 	}
 
 	LivoxClient* this_ptr = (LivoxClient*)client_data;
+	if(this_ptr->m_recorder)
+	{
+		this_ptr->m_recorder->record(LivoxRecordKind::Points, handle, dev_type, data, livoxEthernetPacketSize(data));
+	}
 
-	this_ptr->m_recivedPointMessages[handle]++;
-	const auto laser_id = this_ptr->handleToLidarId(handle);
 	//  printf("point cloud handle: %u, data_num: %d, data_type: %d, length: %d, frame_counter: %d\n",
 	//         handle, data->dot_num, data->data_type, data->length, data->frame_cnt);
 
-	if(data->data_type == kLivoxLidarCartesianCoordinateHighData)
+	uint16_t laser_id;
+	LidarSlot* slot = this_ptr->handleToSlot(handle, laser_id);
+	if(slot == nullptr)
 	{
-		LivoxLidarCartesianHighRawPoint* p_point_data =
-			(LivoxLidarCartesianHighRawPoint*)data->data;
-		std::lock_guard<std::mutex> lcK(this_ptr->m_bufferLidarMutex);
-		ToUint64 toUint64;
-		std::memcpy(toUint64.array, data->timestamp, sizeof(uint64_t));
-		setTimestamp(toUint64.data, this_ptr);
-		this_ptr->m_handleToLastTimestamp[handle] = toUint64.data + this_ptr->systemTimestampDelay;
-
-		if(this_ptr->m_bufferLivoxPtr == nullptr)
-		{
-			return;
-		}
-		auto& buffer = this_ptr->m_bufferLivoxPtr;
-		//buffer->resize(buffer->size() + data->dot_num);
-		for(uint32_t i = 0; i < data->dot_num; i++)
-		{
-			LivoxPoint point;
-			point.point = p_point_data[i];
-			point.laser_id = laser_id;
-			point.timestamp = toUint64.data + i * data->time_interval + this_ptr->systemTimestampDelay;
-			if(point.timestamp > 0){
-				buffer->push_back(point);
-			}
-		}
+		return;
 	}
-	else if(data->data_type == kLivoxLidarCartesianCoordinateLowData)
+	ToUint64 toUint64;
+	std::memcpy(toUint64.array, data->timestamp, sizeof(uint64_t));
+	updatePointStats(slot->stats, data, toUint64.data);
+
+	const size_t pointSize = livoxPointSize(data->data_type);
+	if(pointSize == 0)
 	{
-		LivoxLidarCartesianLowRawPoint* p_point_data = (LivoxLidarCartesianLowRawPoint*)data->data;
+		return;
 	}
-	else if(data->data_type == kLivoxLidarSphericalCoordinateData)
+	const uint64_t arrival = this_ptr->m_replayArrival != 0
+								 ? this_ptr->m_replayArrival
+								 : std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	const uint64_t timestamp = slot->clock.update(toUint64.data, arrival);
+	this_ptr->m_clock.publish(timestamp);
+	slot->lastTimestamp.store(timestamp, std::memory_order_relaxed);
+
+	// only copy the packet here, decoding to points happens on the ingest thread
+	LivoxPointsPacket* packet = slot->points.claim();
+	if(packet == nullptr)
 	{
-		LivoxLidarSpherPoint* p_point_data = (LivoxLidarSpherPoint*)data->data;
+		bump(slot->pointsOverruns);
+		return;
 	}
+	packet->timestamp = timestamp;
+	packet->laser_id = laser_id;
+	packet->time_interval = data->time_interval;
+	packet->dot_num = std::min(data->dot_num, LivoxMaxPointsPerPacket);
+	packet->data_type = data->data_type;
+	std::memcpy(packet->payload, data->data, packet->dot_num * pointSize);
+	slot->points.publish();
 }
 
 void LivoxClient::ImuDataCallback(uint32_t handle,
@@ -314,25 +891,27 @@ void LivoxClient::ImuDataCallback(uint32_t handle,
 	LivoxClient* this_ptr = (LivoxClient*)client_data;
 	if(data->data_type == kLivoxLidarImuData)
 	{
-		const auto laser_id = this_ptr->handleToLidarId(handle);
-		this_ptr->m_recivedImuMsgs[handle]++;
+		if(this_ptr->m_recorder)
+		{
+			this_ptr->m_recorder->record(LivoxRecordKind::Imu, handle, dev_type, data, livoxEthernetPacketSize(data));
+		}
 		LivoxLidarImuRawPoint* p_imu_data = (LivoxLidarImuRawPoint*)data->data;
-		std::lock_guard<std::mutex> lcK(this_ptr->m_bufferImuMutex);
 		ToUint64 toUint64;
 		std::memcpy(toUint64.array, data->timestamp, sizeof(uint64_t));
-		// setTimestamp(toUint64.data, this_ptr); // sync timestamp only with pointclouds
-		if(this_ptr->m_bufferIMUPtr == nullptr)
+		// the clock model is fed only by pointclouds, IMU just converts
+		uint16_t laser_id;
+		LidarSlot* slot = this_ptr->handleToSlot(handle, laser_id);
+		if(slot == nullptr)
 		{
 			return;
 		}
-		auto& buffer = this_ptr->m_bufferIMUPtr;
-		//buffer->resize(buffer->size() + 1);
+		bump(slot->stats.imuPackets);
 		LivoxIMU point;
 		point.point = *p_imu_data;
-		point.timestamp = toUint64.data + this_ptr->systemTimestampDelay;
+		point.timestamp = slot->clock.toSystem(toUint64.data);
 		point.laser_id = laser_id;
-		if(point.timestamp > 0){
-			buffer->push_back(point);
+		if(point.timestamp > 0 && !slot->imu.push(point)){
+			bump(slot->imuOverruns);
 		}
 	}
 }
@@ -484,21 +1063,27 @@ void LivoxClient::LidarInfoChangeCallback(const uint32_t handle,
 	LivoxClient* this_ptr = (LivoxClient*)(client_data);
 	if(this_ptr)
 	{
-		std::lock_guard<std::mutex> lcK(this_ptr->m_lidarInfoMutex);
-		this_ptr->m_LivoxLidarInfo[handle] = *info;
-		this_ptr->m_recivedImuMsgs[handle] = 0;
-		this_ptr->m_recivedPointMessages[handle] = 0;
-		this_ptr->m_handleToLastTimestamp[handle] = 0;
-		const std::string sn(info->sn);
-		this_ptr->m_handleToSerialNumber[handle] = sn;
-		this_ptr->m_serialNumbers.insert(sn);
-		std::cout << " **** Adding lidar " <<sn << " handle " << handle << std::endl;
+		if(this_ptr->m_recorder)
+		{
+			this_ptr->m_recorder->record(LivoxRecordKind::LidarInfo, handle, info->dev_type, info, sizeof(LivoxLidarInfo));
+		}
+		this_ptr->addLidar(handle, *info);
 	}
 }
-uint64_t LivoxClient::getTimestamp()
+
+void LivoxClient::addLidar(uint32_t handle, const LivoxLidarInfo& info)
+{
+	std::lock_guard<std::mutex> lcK(m_lidarInfoMutex);
+	m_LivoxLidarInfo[handle] = info;
+	const std::string sn(info.sn);
+	m_handleToSerialNumber[handle] = sn;
+	m_serialNumbers.insert(sn);
+	rebuildLidarIdTable(m_sessionActive);
+	std::cout << " **** Adding lidar " << sn << " handle " << handle << std::endl;
+}
+uint64_t LivoxClient::getTimestamp() noexcept
 {
-	std::lock_guard<std::mutex> lcK(m_timestampMutex);
-	return m_timestamp;
+	return m_clock.now();
 }
 
 std::unordered_map<uint32_t, std::string> LivoxClient::getSerialNumberToLidarIdMapping() const
@@ -513,39 +1098,215 @@ std::unordered_map<uint32_t, std::string> LivoxClient::getSerialNumberToLidarIdM
 	return ret;
 }
 
+char* LivoxClient::LidarListFormatter::operator()(const std::pair<const uint32_t, std::string>& idSn, char* out) const
+{
+	out = std::to_chars(out, out + 10, idSn.first).ptr;
+	*out++ = ' ';
+	std::memcpy(out, idSn.second.data(), idSn.second.size());
+	return out + idSn.second.size();
+}
+
 uint16_t LivoxClient::handleToLidarId(uint32_t handle) const
 {
-	auto it = m_handleToSerialNumber.find(handle);
-	if(it != m_handleToSerialNumber.end())
+	const auto* entry = m_lidarIdTable.load(std::memory_order_acquire)->find(handle);
+	if(entry != nullptr)
 	{
-		const auto &sn = it->second;
-		auto it2 = m_serialNumbers.find(sn);
-		return std::distance(m_serialNumbers.begin(), it2);
+		return entry->lidarId;
 	}
 
-	return 255;
+	return UnknownLidarId;
 }
 
-void LivoxClient::saveDumpedChunkToDirectory(const std::filesystem::path& directory, int chunk) {
-	imuIteratorToFileSaver.saveDumpedChunkToDirectory(directory, chunk);
-	// lidarIteratorToFileSaver.setBuffer(dumpedSerialNumberToLidarIdMapping.begin(), dumpedSerialNumberToLidarIdMapping.end());
-	lidarIteratorToFileSaver.saveDumpedChunkToDirectory(directory, chunk);
+bool LivoxClient::saveDumpedChunk(DumpedLivoxChunk& dumped, const std::filesystem::path& directory, int chunk)
+{
+	LivoxChunk& data = dumped.data;
+	bool saved = true;
+	if(m_binaryImu)
+	{
+		char imuFileName[64];
+		snprintf(imuFileName, 64, "imu%04d.%s", chunk, ImuBinaryExtension);
+		saved &= saveImuBinary((std::filesystem::path(directory) / imuFileName).string(), *data.imu);
+	}
+	else
+	{
+		IterableToFileSaver<LivoxIMUBuffer, ImuCsvFormatter> imuSaver("csv", "imu");
+		imuSaver.setBuffer(std::move(*data.imu)); // the chunk's deque is not shared, nothing to copy
+		saved &= imuSaver.saveDumpedChunkToDirectory(directory, chunk);
+	}
+	IterableToFileSaver<std::unordered_map<uint32_t, std::string>, LidarListFormatter> lidarSaver("lidar", "ls");
+	lidarSaver.setBuffer(std::move(dumped.lidars));
+	saved &= lidarSaver.saveDumpedChunkToDirectory(directory, chunk);
 
 	char pointcloudFileName[64];
-	snprintf(pointcloudFileName, 64, "lidar%04d.laz", chunk);
-	std::filesystem::path lidarFilePath = std::filesystem::path(directory) / std::filesystem::path(pointcloudFileName);
-	std::cout << "Savig lidar buffer of size " << dumpedBufferLivoxPtr->size() << " to " << lidarFilePath << std::endl;
-	saveLaz(lidarFilePath.string(), dumpedBufferLivoxPtr);
+	snprintf(pointcloudFileName, 64, "lidar%04d", chunk);
+	const std::filesystem::path lidarFileStem = std::filesystem::path(directory) / std::filesystem::path(pointcloudFileName);
+	std::filesystem::path lidarFilePath = lidarFileStem;
+	lidarFilePath += data.stream ? ".laz" : lazExtension(m_lasFormat);
+	if(!data.stream && (data.packets || data.spill || !data.sealed.empty()))
+	{
+		// stitch the chunk back in capture order: spilled segments, sealed segments, last segment.
+		// With deferred expansion per point timestamps are computed only now.
+		auto stitched = std::make_shared<LivoxPointsBuffer>();
+		VoxelDownsampler voxels(m_voxelGridConfig);
+		const auto expand = [&](const LivoxPointsPacket& packet) { appendPacket(packet, *stitched, voxels); };
+		if(m_deferExpansion)
+		{
+			size_t packets = (data.spill ? data.spill->packets() : 0) + (data.packets ? data.packets->size() : 0);
+			for(const auto& segment : data.sealed)
+			{
+				packets += segment.packets ? segment.packets->size() : 0;
+			}
+			stitched->reserve(packets * LivoxMaxPointsPerPacket, packets);
+		}
+		if(data.spill && !data.spill->read(*stitched, expand))
+		{
+			std::cerr << "Lost part of the spilled chunk " << chunk << std::endl;
+			saved = false;
+		}
+		for(const auto& segment : data.sealed)
+		{
+			if(segment.points)
+			{
+				stitched->append(*segment.points);
+			}
+			else if(segment.packets)
+			{
+				segment.packets->forEach(expand);
+			}
+		}
+		if(data.packets)
+		{
+			data.packets->forEach(expand);
+		}
+		else
+		{
+			stitched->append(*data.points);
+		}
+		data.points = stitched;
+		data.packets = nullptr;
+		data.spill = nullptr; // removes the spill file
+		data.sealed.clear();
+	}
+	if(data.stream)
+	{
+		std::cout << "Moving streamed lidar chunk to " << lidarFilePath << std::endl;
+		if(!data.stream->moveTo(lidarFilePath))
+		{
+			std::cerr << "Streamed lidar chunk " << chunk << " is left in " << m_memoryBudget.spillDirectory << std::endl;
+			return false;
+		}
+		dumped.metadata["points"] = pointsStatsToJson(data.stream->stats());
+		data.stream = nullptr;
+	}
+	else if(m_transcoder)
+	{
+		std::filesystem::path rawFilePath = lidarFileStem;
+		rawFilePath += RawPointsExtension;
+		std::cout << "Savig raw lidar buffer of size " << data.points->size() << " to " << rawFilePath << std::endl;
+		saved &= saveRawPoints(rawFilePath.string(), *data.points); // the transcoder gets it once the chunk is committed
+		dumped.metadata["points"] = pointsStatsToJson(data.points->stats);
+	}
+	else
+	{
+		std::cout << "Savig lidar buffer of size " << data.points->size() << " to " << lidarFilePath << std::endl;
+		saved &= saveLazParallel(lidarFilePath.string(), data.points, m_lazThreads, m_lasFormat);
+		dumped.metadata["points"] = pointsStatsToJson(data.points->stats);
+	}
+
+	char metadataFileName[64];
+	snprintf(metadataFileName, 64, "lidar%04d.json", chunk);
+	std::ofstream metadataFile(std::filesystem::path(directory) / std::filesystem::path(metadataFileName));
+	if(metadataFile.fail())
+	{
+		std::cerr << "Error opening file '" << metadataFileName << "' !!" << std::endl;
+		return false;
+	}
+	dumped.metadata["chunk"] = chunk;
+	metadataFile << std::setw(4) << dumped.metadata << std::endl;
+	metadataFile.close();
+	return saved && !metadataFile.fail();
 }
 
-void LivoxClient::dumpChunkInternally() {
-	auto [lidarBuffer, imuBuffer] = retrieveData();
-	auto lidarList = getSerialNumberToLidarIdMapping();
+nlohmann::json LivoxClient::clockModelToJson(const utils::ClockModel& clock)
+{
+	const auto model = clock.parameters();
+	nlohmann::json data;
+	data["offset_ns"] = model.offset;
+	data["drift_ppm"] = model.drift * 1e6;
+	data["reference"] = model.reference;
+	data["windows"] = clock.windows();
+	data["steps"] = clock.steps();
+	return data;
+}
 
-	lidarIteratorToFileSaver.setBuffer(lidarList);
-	imuIteratorToFileSaver.setBuffer(*imuBuffer);
-	dumpedBufferLivoxPtr = lidarBuffer;
-	dumpedBufferImuPtr = imuBuffer; // needed to avoid garbage collection
+nlohmann::json LivoxClient::pointsStatsToJson(const LivoxPointsStats& stats)
+{
+	nlohmann::json data;
+	data["count"] = stats.points;
+	if(stats.points != 0)
+	{
+		data["min"] = {0.001 * stats.minX, 0.001 * stats.minY, 0.001 * stats.minZ};
+		data["max"] = {0.001 * stats.maxX, 0.001 * stats.maxY, 0.001 * stats.maxZ};
+		data["first_timestamp"] = stats.firstTimestamp;
+		data["last_timestamp"] = stats.lastTimestamp;
+	}
+	nlohmann::json perLidar = nlohmann::json::object();
+	for(size_t i = 0; i < stats.pointsPerLidar.size(); i++)
+	{
+		if(stats.pointsPerLidar[i] != 0)
+		{
+			perLidar[std::to_string(i)] = stats.pointsPerLidar[i];
+		}
+	}
+	data["per_lidar"] = perLidar;
+	data["per_return"] = stats.pointsPerReturn;
+	data["reflectivity_histogram"] = stats.reflectivity;
+	return data;
+}
+
+nlohmann::json LivoxClient::produceChunkMetadata()
+{
+	nlohmann::json metadata;
+	auto lidars = nlohmann::json::array();
+	for(size_t i = 0; i < MaxLidars; i++)
+	{
+		const auto& slot = m_lidarSlots[i];
+		const uint32_t handle = slot.handle.load(std::memory_order_acquire);
+		if(handle == FreeSlot)
+		{
+			break;
+		}
+		ChunkCounters now;
+		now.pointPackets = slot.stats.pointPackets.load(std::memory_order_relaxed);
+		now.lostPackets = slot.stats.lostPackets.load(std::memory_order_relaxed);
+		now.reorderedPackets = slot.stats.reorderedPackets.load(std::memory_order_relaxed);
+		now.lostFrames = slot.stats.lostFrames.load(std::memory_order_relaxed);
+		now.overruns = slot.pointsOverruns.load(std::memory_order_relaxed);
+		const ChunkCounters& before = m_lastChunkCounters[i];
+
+		nlohmann::json lidar;
+		lidar["handle"] = handle;
+		lidar["lidar_id"] = handleToLidarId(handle);
+		lidar["point_packets"] = now.pointPackets - before.pointPackets;
+		lidar["lost_packets"] = now.lostPackets - before.lostPackets;
+		lidar["reordered_packets"] = now.reorderedPackets - before.reorderedPackets;
+		lidar["lost_frames"] = now.lostFrames - before.lostFrames;
+		lidar["ring_overruns"] = now.overruns - before.overruns;
+		lidar["clock"] = clockModelToJson(slot.clock);
+		lidars.push_back(lidar);
+		m_lastChunkCounters[i] = now;
+	}
+	metadata["lidars"] = lidars;
+	return metadata;
+}
+
+DumpedChunk LivoxClient::dumpChunk()
+{
+	auto dumped = std::make_shared<DumpedLivoxChunk>();
+	dumped->data = retrieveData();
+	dumped->lidars = getSerialNumberToLidarIdMapping();
+	dumped->metadata = produceChunkMetadata();
+	return [this, dumped](const std::filesystem::path& directory, int chunk) { return saveDumpedChunk(*dumped, directory, chunk); };
 }
 
 std::string LivoxClient::getJsonName()
@@ -0,0 +1,177 @@
+#include "clients/concrete/LivoxReplaySource.h"
+#include "clients/concrete/LivoxClient.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr uint64_t LoopGapNs = 1'000'000; // between the last packet of a pass and the first of the next one
+
+uint64_t packetTimestamp(const LivoxLidarEthernetPacket* packet)
+{
+	uint64_t timestamp;
+	std::memcpy(&timestamp, packet->timestamp, sizeof(timestamp));
+	return timestamp;
+}
+} // namespace
+
+LivoxReplaySource::LivoxReplaySource(std::shared_ptr<LivoxClient> client, const std::string& path, double speed, bool loop)
+	: m_client(std::move(client))
+	, m_reader(path)
+	, m_path(path)
+	, m_speed(speed)
+	, m_loop(loop)
+{ }
+
+LivoxReplaySource::~LivoxReplaySource()
+{
+	stop();
+}
+
+bool LivoxReplaySource::start()
+{
+	if(!m_reader.isOpen() || !m_client->startReplay())
+	{
+		return false;
+	}
+	std::cout << "Replaying Livox recording " << m_path << " at speed " << m_speed << (m_loop ? " in a loop" : "") << std::endl;
+	m_thread = std::thread(&LivoxReplaySource::replayThread, this);
+	return true;
+}
+
+void LivoxReplaySource::stop()
+{
+	m_done = true;
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+nlohmann::json LivoxReplaySource::produceStatus()
+{
+	nlohmann::json data;
+	data["path"] = m_path;
+	data["speed"] = m_speed;
+	data["loop"] = m_loop;
+	data["finished"] = m_finished.load();
+	data["loops"] = m_loops.load(std::memory_order_relaxed);
+	data["packets"] = m_packets.load(std::memory_order_relaxed);
+	data["points"] = m_points.load(std::memory_order_relaxed);
+	data["points_per_second"] = m_pointsPerSecond.load(std::memory_order_relaxed);
+	data["lag_ns"] = m_lagNs.load(std::memory_order_relaxed);
+	return data;
+}
+
+std::string LivoxReplaySource::getJsonName()
+{
+	return "livox_replay";
+}
+
+void LivoxReplaySource::replayThread()
+{
+	alignas(8) uint8_t data[LivoxRecordingReader::MaxRecordSize];
+	auto* packet = reinterpret_cast<LivoxLidarEthernetPacket*>(data);
+	LivoxRecordHeader header;
+
+	// sensor timestamps and arrival times keep growing across passes, the clock of the client never goes back
+	uint64_t firstTimestamp = 0;
+	uint64_t lastTimestamp = 0;
+	uint64_t lastArrival = 0;
+	uint64_t timestampShift = 0;
+	uint64_t arrivalShift = 0;
+	uint64_t passRecords = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	// packets keep their recorded spacing for the clock models of the client, whatever the replay speed
+	const uint64_t startSystem = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	auto sampledAt = start;
+	uint64_t sampledPoints = 0;
+
+	while(!m_done)
+	{
+		if(!m_reader.next(header, data))
+		{
+			if(!m_loop || passRecords == 0)
+			{
+				break;
+			}
+			m_reader.rewind();
+			m_loops.fetch_add(1, std::memory_order_relaxed);
+			timestampShift += lastTimestamp - firstTimestamp + LoopGapNs;
+			arrivalShift += lastArrival + LoopGapNs;
+			passRecords = 0;
+			continue;
+		}
+		passRecords++;
+		lastArrival = header.arrival;
+
+		const auto now = std::chrono::steady_clock::now();
+		if(m_speed > 0)
+		{
+			const auto due = start + std::chrono::nanoseconds(static_cast<uint64_t>((header.arrival + arrivalShift) / m_speed));
+			if(due > now)
+			{
+				std::this_thread::sleep_until(due);
+			}
+			else
+			{
+				m_lagNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count(), std::memory_order_relaxed);
+			}
+		}
+		if(now - sampledAt >= std::chrono::seconds(1))
+		{
+			const uint64_t points = m_points.load(std::memory_order_relaxed);
+			m_pointsPerSecond.store((points - sampledPoints) / std::chrono::duration<double>(now - sampledAt).count(), std::memory_order_relaxed);
+			sampledPoints = points;
+			sampledAt = now;
+		}
+
+		switch(static_cast<LivoxRecordKind>(header.kind))
+		{
+		case LivoxRecordKind::LidarInfo:
+			if(m_loops.load(std::memory_order_relaxed) == 0)
+			{
+				LivoxLidarInfo info{};
+				std::memcpy(&info, data, std::min<size_t>(header.size, sizeof(info)));
+				m_client->addLidar(header.handle, info);
+			}
+			break;
+		case LivoxRecordKind::Points:
+		case LivoxRecordKind::Imu:
+		{
+			const uint64_t timestamp = packetTimestamp(packet);
+			if(m_loops.load(std::memory_order_relaxed) == 0 && header.kind == static_cast<uint8_t>(LivoxRecordKind::Points))
+			{
+				firstTimestamp = firstTimestamp == 0 ? timestamp : std::min(firstTimestamp, timestamp);
+				lastTimestamp = std::max(lastTimestamp, timestamp);
+			}
+			const uint64_t shifted = timestamp + timestampShift;
+			std::memcpy(packet->timestamp, &shifted, sizeof(shifted));
+			m_client->m_replayArrival = startSystem + header.arrival + arrivalShift;
+			if(header.kind == static_cast<uint8_t>(LivoxRecordKind::Points))
+			{
+				LivoxClient::PointCloudCallback(header.handle, header.devType, packet, m_client.get());
+				m_points.fetch_add(std::min(packet->dot_num, LivoxMaxPointsPerPacket), std::memory_order_relaxed);
+			}
+			else
+			{
+				LivoxClient::ImuDataCallback(header.handle, header.devType, packet, m_client.get());
+			}
+			m_packets.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+		default:
+			break; // written by a newer recorder
+		}
+	}
+	m_finished = true;
+	std::cout << "Livox replay finished after " << m_packets.load() << " packets" << std::endl;
+}
+
+} // namespace mandeye
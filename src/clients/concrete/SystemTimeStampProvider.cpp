@@ -1,7 +1,7 @@
 #include "clients/concrete/SystemTimeStampProvider.h"
 #include <chrono>
 
-uint64_t mandeye::SystemTimeStampProvider::getTimestamp()
+uint64_t mandeye::SystemTimeStampProvider::getTimestamp() noexcept
 {
 	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
\ No newline at end of file
@@ -1,10 +1,14 @@
+#include "clients/concrete/ChunkWriter.h"
 #include "clients/concrete/FileSystemClient.h"
 #include "clients/concrete/GnssClient.h"
 #include "clients/concrete/GpioClient.h"
+#include "clients/concrete/LazTranscoder.h"
 #include "clients/concrete/LivoxClient.h"
+#include "clients/concrete/LivoxReplaySource.h"
 #include "clients/concrete/SystemTimeStampProvider.h"
 #include "livox_types.h"
 #include "state_management.h"
+#include "utils/raw_points.h"
 #include "utils/utils.h"
 #include "web/ServerHandler.h"
 #include <chrono>
@@ -19,6 +23,23 @@
 #define SERVER_PORT 8003
 #define MANDEYE_GNSS_UART "/dev/ttyS0"
 #define IGNORE_LIDAR_ERROR false
+// keep the raw point packets of a chunk and expand them to points only when the chunk is saved
+#define MANDEYE_LIVOX_DEFER_EXPANSION false
+#define MANDEYE_LIVOX_FILTER ""
+#define MANDEYE_LIVOX_VOXEL_SIZE "0"
+#define MANDEYE_LIVOX_VOXEL_POINTS "1"
+#define MANDEYE_LIVOX_MEMORY_BUDGET_MB "0" // 0: chunks stay in memory, no spill files
+#define MANDEYE_LIVOX_RECORD ""
+#define MANDEYE_LIVOX_REPLAY ""
+#define MANDEYE_LIVOX_REPLAY_SPEED "1"
+#define MANDEYE_LIVOX_REPLAY_LOOP false
+#define MANDEYE_LAZ_THREADS "1"
+#define MANDEYE_LIVOX_STREAM_LAZ false
+#define MANDEYE_LAS_POINT_FORMAT "1"
+// write chunks as uncompressed .mdpts files while scanning, they are compressed to LAZ when the device is idle
+#define MANDEYE_LIVOX_RAW_FILES false
+#define MANDEYE_IMU_BINARY false
+#define MANDEYE_CHUNK_PIPELINE_DEPTH "1"
 
 using namespace mandeye;
 
@@ -42,9 +63,67 @@ void initializeStateMachineThread(ThreadMap& threads) {
 	std::cout << "State Machine initialized" << std::endl;
 }
 
+//! threads compressing LAZ files, 0 means every core. 1 keeps the single LASzip writer, more use the parallel chunk writer
+unsigned lazThreads()
+{
+	const unsigned threads = utils::getEnvNumber<unsigned>("MANDEYE_LAZ_THREADS", MANDEYE_LAZ_THREADS, 0, 256);
+	return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
 void initializeLivoxClient(bool& lidar_error)
 {
-	std::shared_ptr<LivoxClient> livoxClientPtr = std::make_shared<LivoxClient>();
+	LivoxClientConfig config;
+	config.deferExpansion = utils::getEnvBool("MANDEYE_LIVOX_DEFER_EXPANSION", MANDEYE_LIVOX_DEFER_EXPANSION);
+	config.pointFilter = pointFilterConfigFromString(utils::getEnvString("MANDEYE_LIVOX_FILTER", MANDEYE_LIVOX_FILTER));
+	config.voxelGrid.leafSize = static_cast<uint32_t>(utils::getEnvNumber("MANDEYE_LIVOX_VOXEL_SIZE", MANDEYE_LIVOX_VOXEL_SIZE, 0.0, 100.0) * 1000.0);
+	config.voxelGrid.pointsPerVoxel = utils::getEnvNumber<uint8_t>("MANDEYE_LIVOX_VOXEL_POINTS", MANDEYE_LIVOX_VOXEL_POINTS, 1, 255);
+	config.memoryBudget.bytes = utils::getEnvNumber<size_t>("MANDEYE_LIVOX_MEMORY_BUDGET_MB", MANDEYE_LIVOX_MEMORY_BUDGET_MB, 0, 1024 * 1024) * 1024 * 1024;
+	config.memoryBudget.spillDirectory = utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO);
+	config.lazThreads = lazThreads();
+	config.streamLaz = utils::getEnvBool("MANDEYE_LIVOX_STREAM_LAZ", MANDEYE_LIVOX_STREAM_LAZ);
+	config.lasFormat = lasFormatFromString(utils::getEnvString("MANDEYE_LAS_POINT_FORMAT", MANDEYE_LAS_POINT_FORMAT));
+	config.binaryImu = utils::getEnvBool("MANDEYE_IMU_BINARY", MANDEYE_IMU_BINARY);
+	std::shared_ptr<LivoxClient> livoxClientPtr = std::make_shared<LivoxClient>(config);
+	if(utils::getEnvBool("MANDEYE_LIVOX_RAW_FILES", MANDEYE_LIVOX_RAW_FILES))
+	{
+		// chunks are written uncompressed while scanning and compressed when the device is idle
+		auto transcoderPtr = std::make_shared<LazTranscoder>(utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO),
+															 []() { return app_state == States::IDLE && chunkWriterPtr->pending() == 0; },
+															 lazThreads(),
+															 lasFormatFromString(utils::getEnvString("MANDEYE_LAS_POINT_FORMAT", MANDEYE_LAS_POINT_FORMAT)));
+		livoxClientPtr->setTranscoder(transcoderPtr);
+		chunkWriterPtr->addCommitListener([transcoderPtr](const std::vector<std::filesystem::path>& files) {
+			for(const auto& file : files)
+				if(file.extension() == RawPointsExtension)
+					transcoderPtr->enqueue(file);
+		});
+		std::unique_lock<std::shared_mutex> lock(clientsMutex);
+		jsonReportProducerClients.push_back(transcoderPtr);
+	}
+	const std::string replayPath = utils::getEnvString("MANDEYE_LIVOX_REPLAY", MANDEYE_LIVOX_REPLAY);
+	if(!replayPath.empty())
+	{
+		auto replayPtr = std::make_shared<LivoxReplaySource>(livoxClientPtr,
+															 replayPath,
+															 utils::getEnvNumber("MANDEYE_LIVOX_REPLAY_SPEED", MANDEYE_LIVOX_REPLAY_SPEED, 0.01, 100.0),
+															 utils::getEnvBool("MANDEYE_LIVOX_REPLAY_LOOP", MANDEYE_LIVOX_REPLAY_LOOP));
+		lidar_error = !replayPtr->start();
+		timeStampProviderPtr = livoxClientPtr;
+
+		std::unique_lock<std::shared_mutex> lock(clientsMutex);
+		saveableClients.push_back(std::dynamic_pointer_cast<SaveChunkToDirClient>(livoxClientPtr));
+		loggerClients.push_back(std::dynamic_pointer_cast<LoggerClient>(livoxClientPtr));
+		jsonReportProducerClients.push_back(std::dynamic_pointer_cast<JsonStateProducer>(livoxClientPtr));
+		jsonReportProducerClients.push_back(replayPtr);
+		std::cout << "Livox replay initialized" << std::endl;
+		return;
+	}
+
+	const std::string recordPath = utils::getEnvString("MANDEYE_LIVOX_RECORD", MANDEYE_LIVOX_RECORD);
+	if(!recordPath.empty())
+	{
+		livoxClientPtr->setRecorder(std::make_shared<LivoxPacketRecorder>(recordPath));
+	}
 	if(!livoxClientPtr->startListener(utils::getEnvString("MANDEYE_LIVOX_LISTEN_IP", MANDEYE_LIVOX_LISTEN_IP))){
 		lidar_error = true;
 		if (utils::getEnvBool("IGNORE_LIDAR_ERROR", IGNORE_LIDAR_ERROR)) {
@@ -87,6 +166,18 @@ void initializeFileSystemClient() {
 	std::cout << "FileSystemClient initialized" << std::endl;
 }
 
+void initializeChunkWriter() {
+	// chunks dumped and not saved yet, each one holds its points in memory
+	const size_t depth = utils::getEnvNumber<size_t>("MANDEYE_CHUNK_PIPELINE_DEPTH", MANDEYE_CHUNK_PIPELINE_DEPTH, 1, 64);
+	chunkWriterPtr = std::make_shared<ChunkWriter>(utils::getEnvString("MANDEYE_REPO", MANDEYE_REPO), depth, [](bool busy) {
+		if(gpioClientPtr)
+			gpioClientPtr->setLed(LED::LED_GPIO_COPY_DATA, busy);
+	});
+	std::unique_lock<std::shared_mutex> lock(clientsMutex);
+	jsonReportProducerClients.push_back(chunkWriterPtr);
+	std::cout << "Chunk writer initialized" << std::endl;
+}
+
 void initializeGpioClientThread(ThreadMap& threads) {
 	using namespace std::chrono_literals;
 	const bool simMode = utils::getEnvBool("MANDEYE_GPIO_SIM", MANDEYE_GPIO_SIM);
@@ -142,6 +233,7 @@ int main(int argc, char** argv)
 
 	initializePistacheServerThread(threadsWithNames, server);
 	initializeFileSystemClient();
+	initializeChunkWriter();
 	initializeLivoxClient(lidar_error);
 	initializeGnssClient();
 	initializeStateMachineThread(threadsWithNames);
@@ -201,6 +293,7 @@ int main(int argc, char** argv)
 		std::cout << "joining " << name << " thread" << std::endl;
 		thread->join();
 	}
+	chunkWriterPtr->finish(); // chunks dumped by the state machine before it stopped
 
 	std::cout << "Done" << std::endl;
 	return 0;
@@ -1,11 +1,11 @@
 #include "state_management.h"
+#include "clients/concrete/ChunkWriter.h"
 #include "clients/concrete/FileSystemClient.h"
 #include "clients/concrete/GpioClient.h"
 #include "clients/concrete/LivoxClient.h"
 #include "utils/utils.h"
 #include <iostream>
 #include <string>
-#include <execution>
 
 // in seconds
 #define STOP_SCAN_DURATION 10s
@@ -19,6 +19,7 @@ std::atomic<bool> isRunning{true};
 std::shared_ptr<TimeStampProvider> timeStampProviderPtr;
 std::shared_ptr<GpioClient> gpioClientPtr;
 std::shared_ptr<FileSystemClient> fileSystemClientPtr;
+std::shared_ptr<ChunkWriter> chunkWriterPtr;
 States app_state{States::WAIT_FOR_RESOURCES};
 std::vector<std::shared_ptr<SaveChunkToDirClient>> saveableClients;
 std::vector<std::shared_ptr<LoggerClient>> loggerClients;
@@ -92,22 +93,19 @@ bool saveChunkToDisk(const std::string& outDirectory, int chunk, bool stopScan)
 		app_state = States::USB_IO_ERROR;
 		return false;
 	}
-	gpioClientPtr->setLed(LED::LED_GPIO_COPY_DATA, true);
+	// a scan that stops must be saved, a running chunk can keep recording until the writer catches up
+	if(!chunkWriterPtr->reserve(stopScan))
+		return false;
 
+	std::vector<DumpedChunk> dumps;
 	for(auto& client: saveableClients)
-		client->dumpChunkInternally(); // instant dump
+		dumps.push_back(client->dumpChunk()); // instant dump
 
 	if(stopScan)
 		for(auto& client: loggerClients)
 			client->stopLog();
 
-	// parallelize the saving of the chunks
-	std::for_each(std::execution::par_unseq, saveableClients.begin(), saveableClients.end(), [&outDirectory, chunk](auto& client){
-		client->saveDumpedChunkToDirectory(outDirectory, chunk);
-	});
-
-	utils::syncDisk();
-	gpioClientPtr->setLed(LED::LED_GPIO_COPY_DATA, false);
+	chunkWriterPtr->enqueue(std::move(dumps), outDirectory, chunk);
 	return true;
 }
 
@@ -197,11 +195,12 @@ void stateWatcher()
 
 			if(now - chunkStart > CONTINOUS_SCAN_SAVE_INTERVAL)
 			{
-				chunkStart = std::chrono::steady_clock::now();
-
 				savingDone = saveChunkToDisk(continousScanDirectory, chunksInExperimentCS + chunksInExperimentSS, false);
 				if(savingDone)
+				{
+					chunkStart = now;
 					chunksInExperimentCS++;
+				}
 			}
 			std::this_thread::sleep_for(100ms);
 
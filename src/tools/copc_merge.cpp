@@ -0,0 +1,59 @@
+// Merges the lidar chunks of a session directory into one COPC file.
+// usage: copc_merge <session directory> [output, default <directory>/session.copc.laz] [threads]
+#include "utils/raw_points.h"
+#include "utils/save_laz.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+using namespace mandeye;
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		std::cerr << "usage: copc_merge <session directory> [output] [threads]" << std::endl;
+		return 1;
+	}
+	const std::filesystem::path directory = argv[1];
+	const std::string output = argc > 2 ? argv[2] : (directory / "session.copc.laz").string();
+	const unsigned threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+
+	// lidarNNNN.laz, lidarNNNN.copc.laz or raw lidarNNNN.mdpts not transcoded yet
+	std::vector<std::filesystem::path> chunks;
+	for(const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		const std::string name = entry.path().filename().string();
+		const bool laz = name.size() > 4 && name.compare(name.size() - 4, 4, ".laz") == 0;
+		if(entry.is_regular_file() && name.rfind("lidar", 0) == 0 && (laz || entry.path().extension() == RawPointsExtension))
+		{
+			chunks.push_back(entry.path());
+		}
+	}
+	std::sort(chunks.begin(), chunks.end());
+
+	auto merged = std::make_shared<LivoxPointsBuffer>();
+	for(const auto& chunk : chunks)
+	{
+		bool loaded;
+		if(chunk.extension() == RawPointsExtension)
+		{
+			LivoxPointsBuffer raw;
+			loaded = loadRawPoints(chunk.string(), raw);
+			merged->append(raw);
+		}
+		else
+		{
+			loaded = loadLaz(chunk.string(), *merged);
+		}
+		std::cout << chunk.filename().string() << (loaded ? "" : " FAILED") << ", " << merged->size() << " points" << std::endl;
+	}
+	if(merged->empty())
+	{
+		std::cerr << "no lidar chunks in " << directory << std::endl;
+		return 1;
+	}
+	return saveCopc(output, merged, threads) ? 0 : 1;
+}
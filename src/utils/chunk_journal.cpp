@@ -0,0 +1,335 @@
+#include "utils/chunk_journal.h"
+#include "utils/raw_points.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace mandeye
+{
+
+namespace
+{
+struct JournalFile
+{
+	std::string name;
+	uint64_t size;
+	bool directory;
+};
+
+struct JournalChunk
+{
+	bool synced{false};
+	bool committed{false};
+	bool quarantined{false};
+	std::vector<JournalFile> files; // of the synced line
+};
+
+std::string chunkNumber(int chunk)
+{
+	char number[16];
+	snprintf(number, 16, "%04d", chunk);
+	return number;
+}
+
+bool appendJournal(const std::filesystem::path& session, const std::string& line)
+{
+	const std::filesystem::path path = session / ChunkJournalName;
+	const int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0)
+	{
+		std::cerr << "Error opening " << path << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	const std::string text = line + '\n';
+	const bool written = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()) && fsync(fd) == 0;
+	if(!written)
+	{
+		std::cerr << "Error writing " << path << ": " << strerror(errno) << std::endl;
+	}
+	close(fd);
+	return written;
+}
+
+//! moves the staged entries still there into the session directory, entries moved before a power loss are skipped
+bool finishCommit(const std::filesystem::path& session, int chunk, const std::vector<JournalFile>& files)
+{
+	const std::filesystem::path staging = chunkStagingDirectory(session, chunk);
+	bool moved = true;
+	std::error_code error;
+	for(const auto& file : files)
+	{
+		const std::filesystem::path from = staging / file.name;
+		if(!std::filesystem::exists(from, error))
+		{
+			continue;
+		}
+		std::filesystem::rename(from, session / file.name, error);
+		if(error)
+		{
+			std::cerr << "Error moving " << from << " to " << session << ": " << error.message() << std::endl;
+			moved = false;
+		}
+	}
+	fsyncPath(session);
+	std::filesystem::remove(staging, error);
+	return appendJournal(session, "commit " + chunkNumber(chunk)) && moved;
+}
+
+void quarantine(const std::filesystem::path& session, int chunk, const std::vector<std::filesystem::path>& entries)
+{
+	const std::filesystem::path target = session / QuarantineDirectoryName / ("chunk" + chunkNumber(chunk));
+	std::error_code error;
+	std::filesystem::create_directories(target, error);
+	for(const auto& entry : entries)
+	{
+		std::filesystem::rename(entry, target / entry.filename(), error);
+		if(error)
+		{
+			std::cerr << "Error quarantining " << entry << ": " << error.message() << std::endl;
+		}
+	}
+	fsyncPath(target);
+	fsyncPath(session);
+	appendJournal(session, "quarantined " + chunkNumber(chunk));
+	std::cerr << "Quarantined chunk " << chunk << " of " << session << " to " << target << std::endl;
+}
+
+bool intact(const std::filesystem::path& session, const JournalFile& file)
+{
+	const std::filesystem::path path = session / file.name;
+	std::error_code error;
+	if(file.directory)
+	{
+		return std::filesystem::is_directory(path, error);
+	}
+	const uint64_t size = std::filesystem::file_size(path, error);
+	if(!error)
+	{
+		return size == file.size;
+	}
+	// raw points are replaced by their LAZ once transcoded
+	if(path.extension() == RawPointsExtension)
+	{
+		std::filesystem::path laz = path;
+		laz.replace_extension(".laz");
+		std::filesystem::path copc = path;
+		copc.replace_extension(".copc.laz");
+		return std::filesystem::exists(laz, error) || std::filesystem::exists(copc, error);
+	}
+	return false;
+}
+
+std::map<int, JournalChunk> readJournal(const std::filesystem::path& journalPath, int& lastCommitted, bool& torn)
+{
+	std::ifstream in(journalPath, std::ios::binary);
+	const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	torn = !text.empty() && text.back() != '\n';
+	std::map<int, JournalChunk> chunks;
+	size_t start = 0;
+	for(size_t end = text.find('\n'); end != std::string::npos; start = end + 1, end = text.find('\n', start))
+	{
+		// a last line without its newline was torn by a power loss and is ignored
+		std::istringstream tokens(text.substr(start, end - start));
+		std::string step;
+		int chunk;
+		if(!(tokens >> step >> chunk))
+		{
+			continue;
+		}
+		JournalChunk& state = chunks[chunk];
+		if(step == "begin")
+		{
+			state = JournalChunk{};
+		}
+		else if(step == "synced")
+		{
+			state.synced = true;
+			JournalFile file;
+			while(tokens >> file.name >> file.size)
+			{
+				file.directory = !file.name.empty() && file.name.back() == '/';
+				if(file.directory)
+				{
+					file.name.pop_back();
+				}
+				state.files.push_back(file);
+			}
+		}
+		else if(step == "commit")
+		{
+			state.committed = true;
+			lastCommitted = chunk;
+		}
+		else if(step == "quarantined")
+		{
+			state.quarantined = true;
+		}
+	}
+	return chunks;
+}
+} // namespace
+
+bool fsyncPath(const std::filesystem::path& path)
+{
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		std::cerr << "Error opening " << path << " for fsync: " << strerror(errno) << std::endl;
+		return false;
+	}
+	const bool synced = fsync(fd) == 0;
+	if(!synced)
+	{
+		std::cerr << "Error syncing " << path << ": " << strerror(errno) << std::endl;
+	}
+	close(fd);
+	return synced;
+}
+
+std::filesystem::path chunkStagingDirectory(const std::filesystem::path& session, int chunk)
+{
+	return session / (".chunk" + chunkNumber(chunk) + ".part");
+}
+
+bool beginChunk(const std::filesystem::path& session, int chunk)
+{
+	// journaled first, so a staging directory always has its begin line
+	if(!appendJournal(session, "begin " + chunkNumber(chunk)))
+	{
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::create_directory(chunkStagingDirectory(session, chunk), error);
+	if(error)
+	{
+		std::cerr << "Error creating the staging directory of chunk " << chunk << ": " << error.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool commitChunk(const std::filesystem::path& session, int chunk, std::vector<std::filesystem::path>& committed)
+{
+	std::vector<JournalFile> files;
+	std::error_code error;
+	for(const auto& entry : std::filesystem::directory_iterator(chunkStagingDirectory(session, chunk), error))
+	{
+		JournalFile file{entry.path().filename().string(), 0, entry.is_directory()};
+		if(!file.directory)
+		{
+			file.size = entry.file_size(error);
+		}
+		files.push_back(file);
+	}
+	std::sort(files.begin(), files.end(), [](const JournalFile& a, const JournalFile& b) { return a.name < b.name; });
+
+	std::string line = "synced " + chunkNumber(chunk);
+	for(const auto& file : files)
+	{
+		line += " " + file.name + (file.directory ? "/ " : " ") + std::to_string(file.size);
+	}
+	if(!appendJournal(session, line))
+	{
+		return false;
+	}
+	// once synced is journaled a failed move is finished by recoverChunks
+	finishCommit(session, chunk, files);
+
+	committed.clear();
+	for(const auto& file : files)
+	{
+		committed.push_back(session / file.name);
+	}
+	return true;
+}
+
+void quarantineChunk(const std::filesystem::path& session, int chunk)
+{
+	const std::filesystem::path staging = chunkStagingDirectory(session, chunk);
+	std::vector<std::filesystem::path> staged;
+	std::error_code error;
+	for(const auto& entry : std::filesystem::directory_iterator(staging, error))
+	{
+		staged.push_back(entry.path());
+	}
+	quarantine(session, chunk, staged);
+	std::filesystem::remove(staging, error);
+}
+
+ChunkRecovery recoverChunks(const std::filesystem::path& repository)
+{
+	ChunkRecovery recovery;
+	std::error_code error;
+	for(const auto& entry : std::filesystem::directory_iterator(repository, error))
+	{
+		const std::filesystem::path session = entry.path();
+		const std::filesystem::path journalPath = session / ChunkJournalName;
+		if(!entry.is_directory() || !std::filesystem::exists(journalPath, error))
+		{
+			continue;
+		}
+		recovery.sessions++;
+		int lastCommitted = -1;
+		bool torn = false;
+		auto chunks = readJournal(journalPath, lastCommitted, torn);
+		if(torn)
+		{
+			appendJournal(session, ""); // ends the torn line, the next ones start on their own
+		}
+		for(auto& [chunk, state] : chunks)
+		{
+			if(state.committed || state.quarantined)
+			{
+				continue;
+			}
+			if(state.synced)
+			{
+				// every file is on disk, the power went off while they were moved
+				finishCommit(session, chunk, state.files);
+				recovery.finished++;
+				continue;
+			}
+			const std::filesystem::path staging = chunkStagingDirectory(session, chunk);
+			std::vector<std::filesystem::path> partial;
+			for(const auto& staged : std::filesystem::directory_iterator(staging, error))
+			{
+				partial.push_back(staged.path());
+			}
+			if(!partial.empty())
+			{
+				quarantine(session, chunk, partial);
+				recovery.quarantined++;
+			}
+			std::filesystem::remove(staging, error);
+		}
+		if(lastCommitted >= 0)
+		{
+			const JournalChunk& last = chunks[lastCommitted];
+			std::vector<std::filesystem::path> present;
+			bool damaged = false;
+			for(const auto& file : last.files)
+			{
+				damaged |= !intact(session, file);
+				if(std::filesystem::exists(session / file.name, error))
+				{
+					present.push_back(session / file.name);
+				}
+			}
+			if(damaged && !last.quarantined)
+			{
+				quarantine(session, lastCommitted, present);
+				recovery.quarantined++;
+			}
+		}
+	}
+	return recovery;
+}
+
+} // namespace mandeye
@@ -0,0 +1,192 @@
+#include "utils/chunk_spill.h"
+#include "utils/livox_decode.h"
+#include <iostream>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr uint32_t SegmentMagic = 0x4c50534d; // "MSPL"
+enum SegmentKind : uint32_t
+{
+	PointsSegment = 0,
+	PacketsSegment = 1,
+};
+
+struct SegmentHeader
+{
+	uint32_t magic;
+	uint32_t kind;
+	uint64_t points;
+	uint64_t packets;
+};
+
+template <typename T>
+void writeColumn(std::ofstream& out, const std::vector<T>& column)
+{
+	out.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+}
+
+template <typename T>
+void readColumn(std::ifstream& in, std::vector<T>& column, size_t count)
+{
+	const size_t base = column.size();
+	column.resize(base + count);
+	in.read(reinterpret_cast<char*>(column.data() + base), count * sizeof(T));
+}
+} // namespace
+
+ChunkSpillFile::ChunkSpillFile(std::filesystem::path path)
+	: m_path(std::move(path))
+	, m_out(m_path, std::ios::binary | std::ios::trunc)
+{
+	if(m_out.fail())
+	{
+		std::cerr << "Error opening spill file " << m_path << std::endl;
+	}
+}
+
+ChunkSpillFile::~ChunkSpillFile()
+{
+	m_out.close();
+	std::error_code ec;
+	std::filesystem::remove(m_path, ec);
+}
+
+bool ChunkSpillFile::finishSegment(std::streamoff start)
+{
+	m_out.flush();
+	if(m_out.fail())
+	{
+		// drop the partial segment, the next one overwrites it
+		m_out.clear();
+		m_out.seekp(start);
+		return false;
+	}
+	m_segments++;
+	m_bytes = static_cast<size_t>(m_out.tellp());
+	return true;
+}
+
+bool ChunkSpillFile::write(const LivoxPointsBuffer& points)
+{
+	if(!m_out.is_open())
+	{
+		return false;
+	}
+	const std::streamoff start = m_out.tellp();
+	const SegmentHeader header{SegmentMagic, PointsSegment, points.size(), points.packets()};
+	m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeColumn(m_out, points.x);
+	writeColumn(m_out, points.y);
+	writeColumn(m_out, points.z);
+	writeColumn(m_out, points.reflectivity);
+	writeColumn(m_out, points.tag);
+	writeColumn(m_out, points.line_id);
+	writeColumn(m_out, points.laser_id);
+	writeColumn(m_out, points.timestampOffset);
+	writeColumn(m_out, points.packetTimestamp);
+	writeColumn(m_out, points.packetFirstPoint);
+	if(!finishSegment(start))
+	{
+		return false;
+	}
+	m_points += points.size();
+	m_packets += points.packets();
+	m_pointsStats.merge(points.stats);
+	return true;
+}
+
+bool ChunkSpillFile::write(const LivoxPacketsBuffer& packets)
+{
+	if(!m_out.is_open())
+	{
+		return false;
+	}
+	const std::streamoff start = m_out.tellp();
+	const SegmentHeader header{SegmentMagic, PacketsSegment, 0, packets.size()};
+	m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	packets.forEach([this](const LivoxPointsPacket& packet) {
+		m_out.write(reinterpret_cast<const char*>(&packet.timestamp), sizeof(packet.timestamp));
+		m_out.write(reinterpret_cast<const char*>(&packet.laser_id), sizeof(packet.laser_id));
+		m_out.write(reinterpret_cast<const char*>(&packet.time_interval), sizeof(packet.time_interval));
+		m_out.write(reinterpret_cast<const char*>(&packet.dot_num), sizeof(packet.dot_num));
+		m_out.write(reinterpret_cast<const char*>(&packet.data_type), sizeof(packet.data_type));
+		m_out.write(reinterpret_cast<const char*>(packet.payload), packet.dot_num * livoxPointSize(packet.data_type));
+	});
+	if(!finishSegment(start))
+	{
+		return false;
+	}
+	m_packets += packets.size();
+	m_points += packets.size() * LivoxMaxPointsPerPacket;
+	return true;
+}
+
+bool ChunkSpillFile::read(LivoxPointsBuffer& points, const std::function<void(const LivoxPointsPacket&)>& onPacket)
+{
+	m_out.flush();
+	std::ifstream in(m_path, std::ios::binary);
+	if(in.fail())
+	{
+		std::cerr << "Error opening spill file " << m_path << " for reading" << std::endl;
+		return false;
+	}
+	for(size_t segment = 0; segment < m_segments; segment++)
+	{
+		SegmentHeader header;
+		in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if(in.fail() || header.magic != SegmentMagic)
+		{
+			std::cerr << "Corrupted spill file " << m_path << " at segment " << segment << std::endl;
+			return false;
+		}
+		if(header.kind == PointsSegment)
+		{
+			const uint32_t base = static_cast<uint32_t>(points.size());
+			readColumn(in, points.x, header.points);
+			readColumn(in, points.y, header.points);
+			readColumn(in, points.z, header.points);
+			readColumn(in, points.reflectivity, header.points);
+			readColumn(in, points.tag, header.points);
+			readColumn(in, points.line_id, header.points);
+			readColumn(in, points.laser_id, header.points);
+			readColumn(in, points.timestampOffset, header.points);
+			readColumn(in, points.packetTimestamp, header.packets);
+			const size_t firstPacket = points.packetFirstPoint.size();
+			readColumn(in, points.packetFirstPoint, header.packets);
+			for(size_t p = firstPacket; p < points.packetFirstPoint.size(); p++)
+			{
+				points.packetFirstPoint[p] += base;
+			}
+		}
+		else
+		{
+			LivoxPointsPacket packet;
+			for(uint64_t p = 0; p < header.packets; p++)
+			{
+				in.read(reinterpret_cast<char*>(&packet.timestamp), sizeof(packet.timestamp));
+				in.read(reinterpret_cast<char*>(&packet.laser_id), sizeof(packet.laser_id));
+				in.read(reinterpret_cast<char*>(&packet.time_interval), sizeof(packet.time_interval));
+				in.read(reinterpret_cast<char*>(&packet.dot_num), sizeof(packet.dot_num));
+				in.read(reinterpret_cast<char*>(&packet.data_type), sizeof(packet.data_type));
+				if(in.fail() || packet.dot_num > LivoxMaxPointsPerPacket)
+				{
+					break;
+				}
+				in.read(reinterpret_cast<char*>(packet.payload), packet.dot_num * livoxPointSize(packet.data_type));
+				onPacket(packet);
+			}
+		}
+		if(in.fail())
+		{
+			std::cerr << "Truncated spill file " << m_path << " at segment " << segment << std::endl;
+			return false;
+		}
+	}
+	points.stats.merge(m_pointsStats);
+	return true;
+}
+
+} // namespace mandeye
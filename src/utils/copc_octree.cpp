@@ -0,0 +1,184 @@
+#include "utils/copc_octree.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr size_t GridCellCount = size_t(CopcGridCells) * CopcGridCells * CopcGridCells;
+
+struct Cube
+{
+	double min[3]; // mm
+	double side;
+};
+
+Cube rootCube(const LivoxPointsBuffer& buffer)
+{
+	LivoxPointsStats stats = buffer.stats;
+	if(stats.points != buffer.size())
+	{
+		stats = {};
+		for(size_t i = 0; i < buffer.size(); i++)
+		{
+			stats.add(buffer.x[i], buffer.y[i], buffer.z[i], 0, 0, 0, 0);
+		}
+	}
+	if(stats.points == 0)
+	{
+		return {{0, 0, 0}, 1};
+	}
+	// one mm more keeps the points on the max faces inside the cube
+	const double side = std::max({stats.maxX - stats.minX, stats.maxY - stats.minY, stats.maxZ - stats.minZ}) + 1.0;
+	const double center[3] = {0.5 * (stats.minX + stats.maxX), 0.5 * (stats.minY + stats.maxY), 0.5 * (stats.minZ + stats.maxZ)};
+	return {{center[0] - side / 2, center[1] - side / 2, center[2] - side / 2}, side};
+}
+
+Cube nodeCube(const Cube& root, const CopcKey& key)
+{
+	const double side = root.side / (uint64_t(1) << key.d);
+	return {{root.min[0] + key.x * side, root.min[1] + key.y * side, root.min[2] + key.z * side}, side};
+}
+
+uint32_t gridCoordinate(double coordinate, double min, double cell)
+{
+	const double index = (coordinate - min) / cell;
+	return index <= 0 ? 0 : std::min(static_cast<uint32_t>(index), CopcGridCells - 1);
+}
+
+//! Keeps one point per grid cell in `node`, the rest goes to `children` by octant
+void splitNode(const LivoxPointsBuffer& buffer, const Cube& root, CopcNode& node, std::vector<uint32_t> (&children)[8], std::vector<uint64_t>& occupied)
+{
+	const Cube cube = nodeCube(root, node.key);
+	const double cell = cube.side / CopcGridCells;
+	const double middle[3] = {cube.min[0] + cube.side / 2, cube.min[1] + cube.side / 2, cube.min[2] + cube.side / 2};
+	std::vector<uint32_t> kept;
+	std::vector<uint32_t> keptCells;
+	for(const uint32_t i : node.points)
+	{
+		const size_t cellIndex = (size_t(gridCoordinate(buffer.z[i], cube.min[2], cell)) * CopcGridCells + gridCoordinate(buffer.y[i], cube.min[1], cell)) *
+									 CopcGridCells +
+								 gridCoordinate(buffer.x[i], cube.min[0], cell);
+		uint64_t& word = occupied[cellIndex / 64];
+		const uint64_t bit = uint64_t(1) << (cellIndex % 64);
+		if((word & bit) == 0)
+		{
+			word |= bit;
+			kept.push_back(i);
+			keptCells.push_back(static_cast<uint32_t>(cellIndex));
+			continue;
+		}
+		const int octant = (buffer.x[i] >= middle[0] ? 1 : 0) | (buffer.y[i] >= middle[1] ? 2 : 0) | (buffer.z[i] >= middle[2] ? 4 : 0);
+		children[octant].push_back(i);
+	}
+	// clear only what was set, the bitmap is reused by the next node of the thread
+	for(const uint32_t cellIndex : keptCells)
+	{
+		occupied[cellIndex / 64] = 0;
+	}
+	node.points = std::move(kept);
+}
+} // namespace
+
+CopcOctree buildCopcOctree(const LivoxPointsBuffer& buffer, unsigned threads)
+{
+	const Cube root = rootCube(buffer);
+	CopcOctree octree;
+	for(int axis = 0; axis < 3; axis++)
+	{
+		octree.center[axis] = 0.001 * (root.min[axis] + root.side / 2);
+	}
+	octree.halfSize = 0.001 * root.side / 2;
+	octree.spacing = 0.001 * root.side / CopcGridCells;
+
+	CopcNode first{{0, 0, 0, 0}, {}};
+	first.points.resize(buffer.size());
+	for(uint32_t i = 0; i < buffer.size(); i++)
+	{
+		first.points[i] = i;
+	}
+
+	// nodes of one level are independent, workers take them from a shared queue
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<CopcNode> pending;
+	size_t active = 0;
+	pending.push_back(std::move(first));
+
+	const auto worker = [&]() {
+		std::vector<uint64_t> occupied(GridCellCount / 64);
+		std::unique_lock<std::mutex> lck(mutex);
+		while(true)
+		{
+			condition.wait(lck, [&]() { return !pending.empty() || active == 0; });
+			if(pending.empty())
+			{
+				return; // nothing queued and nobody can queue more
+			}
+			CopcNode node = std::move(pending.front());
+			pending.pop_front();
+			active++;
+			lck.unlock();
+
+			std::vector<uint32_t> children[8];
+			if(node.points.size() > CopcLeafPoints && node.key.d < CopcMaxDepth)
+			{
+				splitNode(buffer, root, node, children, occupied);
+			}
+
+			lck.lock();
+			for(int octant = 0; octant < 8; octant++)
+			{
+				if(!children[octant].empty())
+				{
+					pending.push_back({node.key.child(octant), std::move(children[octant])});
+				}
+			}
+			octree.nodes.push_back(std::move(node));
+			active--;
+			condition.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(unsigned t = 1; t < std::max(1u, threads); t++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for(auto& thread : workers)
+	{
+		thread.join();
+	}
+	return octree;
+}
+
+LivoxPointsBufferPtr gatherCopcNode(const LivoxPointsBuffer& buffer, const CopcNode& node)
+{
+	auto gathered = std::make_shared<LivoxPointsBuffer>();
+	gathered->reserve(node.points.size(), node.points.size() / LivoxMaxPointsPerPacket + 1);
+	const size_t packets = buffer.packets();
+	size_t packet = 0;
+	size_t lastPacket = packets;
+	for(const uint32_t i : node.points)
+	{
+		while(packet + 1 < packets && buffer.packetFirstPoint[packet + 1] <= i)
+		{
+			packet++;
+		}
+		if(packet != lastPacket)
+		{
+			gathered->beginPacket(buffer.packetTimestamp[packet]);
+			lastPacket = packet;
+		}
+		gathered->push(buffer.x[i], buffer.y[i], buffer.z[i], buffer.reflectivity[i], buffer.tag[i], buffer.line_id[i], buffer.laser_id[i], buffer.timestampOffset[i]);
+	}
+	return gathered;
+}
+
+} // namespace mandeye
@@ -0,0 +1,127 @@
+#include "utils/imu_log.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr char ImuMagic[8] = {'M', 'D', 'I', 'M', 'U', 0, 0, 0};
+constexpr uint32_t ImuVersion = 1;
+constexpr size_t RecordsPerWrite = 4096;
+
+#pragma pack(push, 1)
+struct ImuFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t records;
+};
+
+struct ImuRecord
+{
+	uint64_t timestamp;
+	float gyro[3];
+	float acc[3];
+	uint16_t laserId;
+	uint16_t reserved;
+};
+#pragma pack(pop)
+static_assert(sizeof(ImuFileHeader) == 24 && sizeof(ImuRecord) == 36);
+
+// 6 significant digits, as operator<< of a float with the default precision
+char* formatFloat(char* out, float value)
+{
+	return std::to_chars(out, out + 16, value, std::chars_format::general, 6).ptr;
+}
+} // namespace
+
+char* formatImuCsv(const LivoxIMU& imu, char* out)
+{
+	out = std::to_chars(out, out + 20, imu.timestamp).ptr;
+	const float values[6] = {imu.point.gyro_x, imu.point.gyro_y, imu.point.gyro_z, imu.point.acc_x, imu.point.acc_y, imu.point.acc_z};
+	for(const float value : values)
+	{
+		*out++ = ' ';
+		out = formatFloat(out, value);
+	}
+	*out++ = ' ';
+	return std::to_chars(out, out + 5, imu.laser_id).ptr;
+}
+
+bool saveImuBinary(const std::string& filename, const LivoxIMUBuffer& imu)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	ImuFileHeader header;
+	std::memcpy(header.magic, ImuMagic, sizeof(header.magic));
+	header.version = ImuVersion;
+	header.recordSize = sizeof(ImuRecord);
+	header.records = imu.size();
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<ImuRecord> records;
+	records.reserve(RecordsPerWrite);
+	const auto flush = [&]() {
+		out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(ImuRecord));
+		records.clear();
+	};
+	for(const auto& sample : imu)
+	{
+		const auto& p = sample.point;
+		records.push_back({sample.timestamp, {p.gyro_x, p.gyro_y, p.gyro_z}, {p.acc_x, p.acc_y, p.acc_z}, sample.laser_id, 0});
+		if(records.size() == RecordsPerWrite)
+		{
+			flush();
+		}
+	}
+	flush();
+	out.close();
+	if(out.fail())
+	{
+		std::cerr << "Error writing IMU to " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadImuBinary(const std::string& filename, LivoxIMUBuffer& imu)
+{
+	std::ifstream in(filename, std::ios::binary);
+	ImuFileHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(in.fail() || std::memcmp(header.magic, ImuMagic, sizeof(header.magic)) != 0 || header.version != ImuVersion ||
+	   header.recordSize < sizeof(ImuRecord))
+	{
+		std::cerr << "Not a binary IMU file " << filename << std::endl;
+		return false;
+	}
+	ImuRecord record;
+	for(uint64_t r = 0; r < header.records; r++)
+	{
+		in.read(reinterpret_cast<char*>(&record), sizeof(record));
+		in.ignore(header.recordSize - sizeof(record)); // fields of a newer version
+		if(in.fail())
+		{
+			std::cerr << "Truncated binary IMU file " << filename << std::endl;
+			return false;
+		}
+		LivoxIMU sample{};
+		sample.timestamp = record.timestamp;
+		sample.point.gyro_x = record.gyro[0];
+		sample.point.gyro_y = record.gyro[1];
+		sample.point.gyro_z = record.gyro[2];
+		sample.point.acc_x = record.acc[0];
+		sample.point.acc_y = record.acc[1];
+		sample.point.acc_z = record.acc[2];
+		sample.laser_id = record.laserId;
+		imu.push_back(sample);
+	}
+	return true;
+}
+
+} // namespace mandeye
@@ -0,0 +1,38 @@
+// LASzip entropy coder internals, kept out of every other translation unit
+#include "utils/laz_chunk_table.h"
+#include "arithmeticencoder.hpp"
+#include "bytestreamout_ostream.hpp"
+#include "integercompressor.hpp"
+
+namespace mandeye
+{
+
+bool writeLazChunkTable(std::ostream& stream, const std::vector<uint32_t>& chunkBytes, const std::vector<uint32_t>& chunkPoints)
+{
+	ByteStreamOutOstreamLE out(stream);
+	const U32 version = 0;
+	const U32 chunks = static_cast<U32>(chunkBytes.size());
+	if(!out.put32bitsLE(reinterpret_cast<const U8*>(&version)) || !out.put32bitsLE(reinterpret_cast<const U8*>(&chunks)))
+	{
+		return false;
+	}
+	if(chunks > 0)
+	{
+		ArithmeticEncoder encoder;
+		encoder.init(&out);
+		IntegerCompressor compressor(&encoder, 32, 2);
+		compressor.initCompressor();
+		for(size_t i = 0; i < chunkBytes.size(); i++)
+		{
+			if(!chunkPoints.empty())
+			{
+				compressor.compress(i ? chunkPoints[i - 1] : 0, chunkPoints[i], 0);
+			}
+			compressor.compress(i ? chunkBytes[i - 1] : 0, chunkBytes[i], 1);
+		}
+		encoder.done();
+	}
+	return stream.good();
+}
+
+} // namespace mandeye
@@ -0,0 +1,183 @@
+#include "utils/livox_decode.h"
+#include "utils/simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace mandeye
+{
+
+namespace
+{
+// Low precision cartesian points are in centimeters
+constexpr int32_t LowDataScale = 10;
+// Spherical angles are in hundredths of degree: theta in [0, 180], phi in [0, 360]
+constexpr uint32_t AngleSteps = 36000;
+constexpr uint32_t QuarterTurn = AngleSteps / 4;
+
+//! sin of every angle step over 450 degrees, cos(a) is read as sin(a + 90)
+struct SinTable
+{
+	float values[AngleSteps + QuarterTurn + 1];
+
+	SinTable()
+	{
+		for(uint32_t i = 0; i <= AngleSteps + QuarterTurn; i++)
+		{
+			values[i] = static_cast<float>(std::sin(i * M_PI / (AngleSteps / 2)));
+		}
+	}
+	float sin(uint16_t angle) const
+	{
+		return values[std::min<uint32_t>(angle, AngleSteps)];
+	}
+	float cos(uint16_t angle) const
+	{
+		return values[std::min<uint32_t>(angle, AngleSteps) + QuarterTurn];
+	}
+};
+
+const SinTable& sinTable()
+{
+	static const SinTable table;
+	return table;
+}
+
+void copyReflectivityAndTag(const auto* in, size_t count, DecodedPoints& out)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		out.reflectivity[i] = in[i].reflectivity;
+		out.tag[i] = in[i].tag;
+	}
+}
+} // namespace
+
+size_t livoxPointSize(uint8_t dataType)
+{
+	switch(dataType)
+	{
+	case kLivoxLidarCartesianCoordinateHighData:
+		return sizeof(LivoxLidarCartesianHighRawPoint);
+	case kLivoxLidarCartesianCoordinateLowData:
+		return sizeof(LivoxLidarCartesianLowRawPoint);
+	case kLivoxLidarSphericalCoordinateData:
+		return sizeof(LivoxLidarSpherPoint);
+	default:
+		return 0;
+	}
+}
+
+size_t decodeLivoxPoints(uint8_t dataType, const uint8_t* payload, size_t count, DecodedPoints& out)
+{
+	count = std::min<size_t>(count, LivoxMaxPointsPerPacket);
+	switch(dataType)
+	{
+	case kLivoxLidarCartesianCoordinateHighData:
+		decodeCartesianHigh(reinterpret_cast<const LivoxLidarCartesianHighRawPoint*>(payload), count, out);
+		return count;
+	case kLivoxLidarCartesianCoordinateLowData:
+		decodeCartesianLow(reinterpret_cast<const LivoxLidarCartesianLowRawPoint*>(payload), count, out);
+		return count;
+	case kLivoxLidarSphericalCoordinateData:
+		decodeSpherical(reinterpret_cast<const LivoxLidarSpherPoint*>(payload), count, out);
+		return count;
+	default:
+		return 0;
+	}
+}
+
+void decodeCartesianHigh(const LivoxLidarCartesianHighRawPoint* in, size_t count, DecodedPoints& out)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		out.x[i] = in[i].x;
+		out.y[i] = in[i].y;
+		out.z[i] = in[i].z;
+	}
+	copyReflectivityAndTag(in, count, out);
+}
+
+void decodeCartesianLow(const LivoxLidarCartesianLowRawPoint* in, size_t count, DecodedPoints& out)
+{
+	static_assert(sizeof(LivoxLidarCartesianLowRawPoint) == 4 * sizeof(int16_t), "low point is x, y, z and reflectivity|tag");
+	static_assert(LowDataScale == 10, "kernel multiplies by 10 as (v << 3) + (v << 1)");
+	const auto* raw = reinterpret_cast<const int16_t*>(in);
+	const auto times10 = [](simd::i32x4 v) { return simd::add(simd::shiftLeft<3>(v), simd::shiftLeft<1>(v)); };
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		simd::i32x4 x, y, z, reflectivityAndTag;
+		simd::deinterleave4x16(raw + 4 * i, x, y, z, reflectivityAndTag);
+		simd::store(out.x + i, times10(x));
+		simd::store(out.y + i, times10(y));
+		simd::store(out.z + i, times10(z));
+	}
+	for(; i < count; i++)
+	{
+		out.x[i] = in[i].x * LowDataScale;
+		out.y[i] = in[i].y * LowDataScale;
+		out.z[i] = in[i].z * LowDataScale;
+	}
+	copyReflectivityAndTag(in, count, out);
+}
+
+void decodeSpherical(const LivoxLidarSpherPoint* in, size_t count, DecodedPoints& out)
+{
+	const SinTable& table = sinTable();
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		// table lookups are gathers, the arithmetic runs 4 wide
+		alignas(16) float depth[4], sinTheta[4], cosTheta[4], sinPhi[4], cosPhi[4];
+		for(size_t k = 0; k < 4; k++)
+		{
+			const auto& p = in[i + k];
+			depth[k] = static_cast<float>(p.depth);
+			sinTheta[k] = table.sin(p.theta);
+			cosTheta[k] = table.cos(p.theta);
+			sinPhi[k] = table.sin(p.phi);
+			cosPhi[k] = table.cos(p.phi);
+		}
+		const simd::f32x4 d = simd::load(depth);
+		const simd::f32x4 r = simd::mul(d, simd::load(sinTheta));
+		simd::store(out.x + i, simd::toInt(simd::mul(r, simd::load(cosPhi))));
+		simd::store(out.y + i, simd::toInt(simd::mul(r, simd::load(sinPhi))));
+		simd::store(out.z + i, simd::toInt(simd::mul(d, simd::load(cosTheta))));
+	}
+	for(; i < count; i++)
+	{
+		const auto& p = in[i];
+		const float r = p.depth * table.sin(p.theta);
+		out.x[i] = static_cast<int32_t>(std::lround(r * table.cos(p.phi)));
+		out.y[i] = static_cast<int32_t>(std::lround(r * table.sin(p.phi)));
+		out.z[i] = static_cast<int32_t>(std::lround(p.depth * table.cos(p.theta)));
+	}
+	copyReflectivityAndTag(in, count, out);
+}
+
+void decodeCartesianLowScalar(const LivoxLidarCartesianLowRawPoint* in, size_t count, DecodedPoints& out)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		out.x[i] = in[i].x * LowDataScale;
+		out.y[i] = in[i].y * LowDataScale;
+		out.z[i] = in[i].z * LowDataScale;
+	}
+	copyReflectivityAndTag(in, count, out);
+}
+
+void decodeSphericalScalar(const LivoxLidarSpherPoint* in, size_t count, DecodedPoints& out)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		const auto& p = in[i];
+		const double theta = p.theta * M_PI / (AngleSteps / 2);
+		const double phi = p.phi * M_PI / (AngleSteps / 2);
+		out.x[i] = static_cast<int32_t>(std::lround(p.depth * std::sin(theta) * std::cos(phi)));
+		out.y[i] = static_cast<int32_t>(std::lround(p.depth * std::sin(theta) * std::sin(phi)));
+		out.z[i] = static_cast<int32_t>(std::lround(p.depth * std::cos(theta)));
+	}
+	copyReflectivityAndTag(in, count, out);
+}
+
+} // namespace mandeye
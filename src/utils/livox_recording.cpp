@@ -0,0 +1,173 @@
+#include "utils/livox_recording.h"
+#include "utils/livox_decode.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr char RecordingMagic[8] = {'M', 'D', 'L', 'V', 'X', 'R', 'E', 'C'};
+constexpr uint32_t RecordingVersion = 1;
+constexpr auto FlushPeriod = std::chrono::milliseconds(100);
+} // namespace
+
+size_t livoxEthernetPacketSize(const LivoxLidarEthernetPacket* packet)
+{
+	const size_t header = offsetof(LivoxLidarEthernetPacket, data);
+	if(packet->data_type == kLivoxLidarImuData)
+	{
+		return header + sizeof(LivoxLidarImuRawPoint);
+	}
+	return header + std::min<size_t>(packet->dot_num, LivoxMaxPointsPerPacket) * livoxPointSize(packet->data_type);
+}
+
+LivoxPacketRecorder::LivoxPacketRecorder(const std::string& path)
+	: m_file(path, std::ios::binary | std::ios::trunc)
+	, m_start(std::chrono::steady_clock::now())
+{
+	if(m_file.fail())
+	{
+		std::cerr << "Cannot open Livox recording " << path << std::endl;
+		m_file.close();
+		return;
+	}
+	m_file.write(RecordingMagic, sizeof(RecordingMagic));
+	m_file.write(reinterpret_cast<const char*>(&RecordingVersion), sizeof(RecordingVersion));
+	m_writer = std::thread(&LivoxPacketRecorder::writerThread, this);
+}
+
+LivoxPacketRecorder::~LivoxPacketRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_done = true;
+	}
+	m_condition.notify_one();
+	if(m_writer.joinable())
+	{
+		m_writer.join();
+	}
+}
+
+void LivoxPacketRecorder::record(LivoxRecordKind kind, uint32_t handle, uint8_t devType, const void* data, size_t size)
+{
+	if(!isOpen())
+	{
+		return;
+	}
+	auto& ring = kind == LivoxRecordKind::Points ? m_points : kind == LivoxRecordKind::Imu ? m_imu : m_info;
+	Record* record = size <= LivoxMaxRecordSize ? ring.claim() : nullptr;
+	if(record == nullptr)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	record->header = LivoxRecordHeader{
+		static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count()),
+		handle,
+		static_cast<uint16_t>(size),
+		static_cast<uint8_t>(kind),
+		devType};
+	std::memcpy(record->data, data, size);
+	ring.publish();
+}
+
+void LivoxPacketRecorder::flush(bool all)
+{
+	// every ring is in arrival order on its own. A record stamped just before the rings are drained can be published
+	// just after, so the newest flush period stays staged and is merged with the next batch
+	const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+	const uint64_t horizon = all ? std::numeric_limits<uint64_t>::max() : elapsed - std::min<uint64_t>(elapsed, std::chrono::nanoseconds(FlushPeriod).count());
+	const auto stage = [this](const Record& record) {
+		m_order.emplace_back(record.header.arrival, m_staged.size());
+		const auto* bytes = reinterpret_cast<const char*>(&record);
+		m_staged.insert(m_staged.end(), bytes, bytes + sizeof(record.header) + record.header.size);
+	};
+	m_info.consumeAll(stage);
+	m_imu.consumeAll(stage);
+	m_points.consumeAll(stage);
+	std::stable_sort(m_order.begin(), m_order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	const auto due = std::upper_bound(m_order.begin(), m_order.end(), horizon, [](uint64_t h, const auto& o) { return h < o.first; });
+	uint64_t written = 0;
+	for(auto it = m_order.begin(); it != due && m_file.good(); ++it)
+	{
+		const auto* header = reinterpret_cast<const LivoxRecordHeader*>(m_staged.data() + it->second);
+		written += m_file.write(m_staged.data() + it->second, sizeof(LivoxRecordHeader) + header->size).good();
+	}
+	m_records.fetch_add(written, std::memory_order_relaxed);
+
+	std::vector<char> kept;
+	std::vector<std::pair<uint64_t, size_t>> keptOrder;
+	for(auto it = due; it != m_order.end(); ++it)
+	{
+		const auto* header = reinterpret_cast<const LivoxRecordHeader*>(m_staged.data() + it->second);
+		keptOrder.emplace_back(it->first, kept.size());
+		kept.insert(kept.end(), m_staged.data() + it->second, m_staged.data() + it->second + sizeof(LivoxRecordHeader) + header->size);
+	}
+	m_staged = std::move(kept);
+	m_order = std::move(keptOrder);
+}
+
+void LivoxPacketRecorder::writerThread()
+{
+	bool done = false;
+	while(!done)
+	{
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_condition.wait_for(lck, FlushPeriod, [this]() { return m_done; });
+			done = m_done;
+		}
+		flush(done);
+	}
+	m_file.flush();
+	if(m_file.fail())
+	{
+		std::cerr << "Error writing Livox recording" << std::endl;
+	}
+}
+
+LivoxRecordingReader::LivoxRecordingReader(const std::string& path)
+	: m_file(path, std::ios::binary)
+{
+	char magic[sizeof(RecordingMagic)];
+	uint32_t version = 0;
+	m_file.read(magic, sizeof(magic));
+	m_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if(m_file.fail() || std::memcmp(magic, RecordingMagic, sizeof(magic)) != 0 || version != RecordingVersion)
+	{
+		std::cerr << "Not a Livox recording: " << path << std::endl;
+		return;
+	}
+	m_firstRecord = m_file.tellg();
+	m_valid = true;
+}
+
+bool LivoxRecordingReader::next(LivoxRecordHeader& header, uint8_t* data)
+{
+	if(!m_valid)
+	{
+		return false;
+	}
+	m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(m_file.fail() || header.size > MaxRecordSize)
+	{
+		return false;
+	}
+	m_file.read(reinterpret_cast<char*>(data), header.size);
+	return !m_file.fail();
+}
+
+void LivoxRecordingReader::rewind()
+{
+	m_file.clear();
+	m_file.seekg(m_firstRecord);
+}
+
+} // namespace mandeye
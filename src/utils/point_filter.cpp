@@ -0,0 +1,216 @@
+#include "utils/point_filter.h"
+#include "utils/simd.h"
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace mandeye
+{
+
+namespace
+{
+enum RejectedBy : uint8_t
+{
+	RejectedByRange = 1,
+	RejectedByBox = 2,
+	RejectedByTag = 4,
+	RejectedByReflectivity = 8,
+};
+
+int32_t metersToMillimeters(double meters)
+{
+	return static_cast<int32_t>(std::lround(meters * 1000.0));
+}
+
+//! finite and within the int32 millimeters of the config
+bool validDistance(double meters)
+{
+	return std::isfinite(meters) && std::abs(meters) <= 1e6;
+}
+
+PointFilterConfig rejectConfig(const char* reason)
+{
+	std::cerr << "Invalid point filter: " << reason << ", filter disabled" << std::endl;
+	return {};
+}
+
+//! range and box tests of a single point, same result as the SIMD kernel
+uint8_t geometryTest(const PointFilterConfig& config, float minRange2, float maxRange2, int32_t x, int32_t y, int32_t z)
+{
+	uint8_t rejected = 0;
+	const float fx = static_cast<float>(x);
+	const float fy = static_cast<float>(y);
+	const float fz = static_cast<float>(z);
+	const float range2 = fx * fx + fy * fy + fz * fz;
+	if(minRange2 > range2 || range2 > maxRange2)
+	{
+		rejected |= RejectedByRange;
+	}
+	if(config.excludeBox && x >= config.boxMin[0] && x <= config.boxMax[0] && y >= config.boxMin[1] && y <= config.boxMax[1] &&
+	   z >= config.boxMin[2] && z <= config.boxMax[2])
+	{
+		rejected |= RejectedByBox;
+	}
+	return rejected;
+}
+} // namespace
+
+PointFilterConfig pointFilterConfigFromJson(const nlohmann::json& json)
+{
+	PointFilterConfig config;
+	if(!json.is_object() || json.empty())
+	{
+		return config;
+	}
+	const double minRange = json.value("min_range", 0.0);
+	const double maxRange = json.value("max_range", 0.0);
+	const int64_t rejectTagMask = json.value("reject_tag_mask", int64_t{0});
+	const int64_t minReflectivity = json.value("min_reflectivity", int64_t{0});
+	if(!validDistance(minRange) || !validDistance(maxRange) || minRange < 0 || maxRange < 0 || (maxRange != 0 && minRange > maxRange))
+	{
+		return rejectConfig("min_range and max_range must be 0 <= min_range <= max_range meters");
+	}
+	if(rejectTagMask < 0 || rejectTagMask > 255 || minReflectivity < 0 || minReflectivity > 255)
+	{
+		return rejectConfig("reject_tag_mask and min_reflectivity must be 0 to 255");
+	}
+	config.enabled = true;
+	config.minRange = metersToMillimeters(minRange);
+	config.maxRange = metersToMillimeters(maxRange);
+	if(json.contains("exclude_box"))
+	{
+		const auto& box = json.at("exclude_box");
+		const auto& min = box.at("min");
+		const auto& max = box.at("max");
+		if(!min.is_array() || min.size() != 3 || !max.is_array() || max.size() != 3)
+		{
+			return rejectConfig("exclude_box min and max must be [x, y, z]");
+		}
+		config.excludeBox = true;
+		for(int i = 0; i < 3; i++)
+		{
+			const double boxMin = min[i].get<double>();
+			const double boxMax = max[i].get<double>();
+			if(!validDistance(boxMin) || !validDistance(boxMax) || boxMin > boxMax)
+			{
+				return rejectConfig("exclude_box min must not exceed max");
+			}
+			config.boxMin[i] = metersToMillimeters(boxMin);
+			config.boxMax[i] = metersToMillimeters(boxMax);
+		}
+	}
+	config.rejectTagMask = static_cast<uint8_t>(rejectTagMask);
+	config.minReflectivity = static_cast<uint8_t>(minReflectivity);
+	return config;
+}
+
+PointFilterConfig pointFilterConfigFromString(const std::string& jsonOrPath)
+{
+	if(jsonOrPath.empty())
+	{
+		return {};
+	}
+	try
+	{
+		if(jsonOrPath.front() == '{')
+		{
+			return pointFilterConfigFromJson(nlohmann::json::parse(jsonOrPath));
+		}
+		std::ifstream file(jsonOrPath);
+		if(file.fail())
+		{
+			std::cerr << "Cannot open point filter file '" << jsonOrPath << "', filter disabled" << std::endl;
+			return {};
+		}
+		return pointFilterConfigFromJson(nlohmann::json::parse(file));
+	}
+	catch(const nlohmann::json::exception& e)
+	{
+		std::cerr << "Invalid point filter '" << jsonOrPath << "': " << e.what() << ", filter disabled" << std::endl;
+		return {};
+	}
+}
+
+nlohmann::json pointFilterConfigToJson(const PointFilterConfig& config)
+{
+	nlohmann::json json;
+	json["enabled"] = config.enabled;
+	json["min_range"] = config.minRange / 1000.0;
+	json["max_range"] = config.maxRange / 1000.0;
+	if(config.excludeBox)
+	{
+		json["exclude_box"]["min"] = {config.boxMin[0] / 1000.0, config.boxMin[1] / 1000.0, config.boxMin[2] / 1000.0};
+		json["exclude_box"]["max"] = {config.boxMax[0] / 1000.0, config.boxMax[1] / 1000.0, config.boxMax[2] / 1000.0};
+	}
+	json["reject_tag_mask"] = config.rejectTagMask;
+	json["min_reflectivity"] = config.minReflectivity;
+	return json;
+}
+
+size_t filterPoints(const PointFilterConfig& config, const DecodedPoints& points, size_t count, uint8_t* keep, PointFilterCounters& counters)
+{
+	uint8_t rejected[LivoxMaxPointsPerPacket];
+	const float minRange2 = static_cast<float>(config.minRange) * static_cast<float>(config.minRange);
+	const float maxRange2 =
+		config.maxRange == 0 ? std::numeric_limits<float>::infinity() : static_cast<float>(config.maxRange) * static_cast<float>(config.maxRange);
+
+	// range and box, four points per step
+	const simd::f32x4 minRange2v = simd::set1(minRange2);
+	const simd::f32x4 maxRange2v = simd::set1(maxRange2);
+	const simd::i32x4 boxEnabled = simd::set1(int32_t(config.excludeBox ? -1 : 0));
+	const simd::i32x4 boxMinX = simd::set1(config.boxMin[0] - 1);
+	const simd::i32x4 boxMinY = simd::set1(config.boxMin[1] - 1);
+	const simd::i32x4 boxMinZ = simd::set1(config.boxMin[2] - 1);
+	const simd::i32x4 boxMaxX = simd::set1(config.boxMax[0] + 1);
+	const simd::i32x4 boxMaxY = simd::set1(config.boxMax[1] + 1);
+	const simd::i32x4 boxMaxZ = simd::set1(config.boxMax[2] + 1);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		const simd::i32x4 x = simd::load(points.x + i);
+		const simd::i32x4 y = simd::load(points.y + i);
+		const simd::i32x4 z = simd::load(points.z + i);
+		const simd::f32x4 fx = simd::toFloat(x);
+		const simd::f32x4 fy = simd::toFloat(y);
+		const simd::f32x4 fz = simd::toFloat(z);
+		const simd::f32x4 range2 = simd::add(simd::add(simd::mul(fx, fx), simd::mul(fy, fy)), simd::mul(fz, fz));
+		const int rangeMask = simd::moveMask(simd::bitOr(simd::greater(minRange2v, range2), simd::greater(range2, maxRange2v)));
+
+		simd::i32x4 inside = simd::bitAnd(boxEnabled, simd::bitAnd(simd::greater(x, boxMinX), simd::greater(boxMaxX, x)));
+		inside = simd::bitAnd(inside, simd::bitAnd(simd::greater(y, boxMinY), simd::greater(boxMaxY, y)));
+		inside = simd::bitAnd(inside, simd::bitAnd(simd::greater(z, boxMinZ), simd::greater(boxMaxZ, z)));
+		const int boxMask = simd::moveMask(inside);
+
+		for(int lane = 0; lane < 4; lane++)
+		{
+			rejected[i + lane] = ((rangeMask >> lane) & 1) * RejectedByRange | ((boxMask >> lane) & 1) * RejectedByBox;
+		}
+	}
+	for(; i < count; i++)
+	{
+		rejected[i] = geometryTest(config, minRange2, maxRange2, points.x[i], points.y[i], points.z[i]);
+	}
+
+	// byte columns, plain loops the compiler vectorizes
+	for(i = 0; i < count; i++)
+	{
+		rejected[i] |= (points.tag[i] & config.rejectTagMask) != 0 ? RejectedByTag : 0;
+		rejected[i] |= points.reflectivity[i] < config.minReflectivity ? RejectedByReflectivity : 0;
+	}
+
+	size_t kept = 0;
+	for(i = 0; i < count; i++)
+	{
+		counters.range += (rejected[i] & RejectedByRange) != 0;
+		counters.box += (rejected[i] & RejectedByBox) != 0;
+		counters.tag += (rejected[i] & RejectedByTag) != 0;
+		counters.reflectivity += (rejected[i] & RejectedByReflectivity) != 0;
+		keep[i] = rejected[i] == 0;
+		kept += keep[i];
+	}
+	counters.rejected += count - kept;
+	return kept;
+}
+
+} // namespace mandeye
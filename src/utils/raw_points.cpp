@@ -0,0 +1,107 @@
+#include "utils/raw_points.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace mandeye
+{
+
+namespace
+{
+constexpr char RawPointsMagic[8] = {'M', 'D', 'P', 'O', 'I', 'N', 'T', 'S'};
+constexpr uint32_t RawPointsVersion = 1;
+constexpr size_t ColumnAlignment = 8;
+
+struct RawPointsHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize; // of this struct, columns start after it
+	uint64_t points;
+	uint64_t packets;
+	LivoxPointsStats stats;
+};
+static_assert(std::is_trivially_copyable_v<RawPointsHeader>);
+static_assert(sizeof(RawPointsHeader) % ColumnAlignment == 0);
+
+template <typename T>
+void writeColumn(std::ofstream& out, const std::vector<T>& column)
+{
+	static const char padding[ColumnAlignment] = {};
+	const size_t bytes = column.size() * sizeof(T);
+	out.write(reinterpret_cast<const char*>(column.data()), bytes);
+	out.write(padding, (ColumnAlignment - bytes % ColumnAlignment) % ColumnAlignment);
+}
+
+template <typename T>
+void readColumn(std::ifstream& in, std::vector<T>& column, size_t count)
+{
+	const size_t bytes = count * sizeof(T);
+	column.resize(count);
+	in.read(reinterpret_cast<char*>(column.data()), bytes);
+	in.ignore((ColumnAlignment - bytes % ColumnAlignment) % ColumnAlignment);
+}
+} // namespace
+
+bool saveRawPoints(const std::string& filename, const LivoxPointsBuffer& buffer)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	RawPointsHeader header{};
+	std::memcpy(header.magic, RawPointsMagic, sizeof(header.magic));
+	header.version = RawPointsVersion;
+	header.headerSize = sizeof(header);
+	header.points = buffer.size();
+	header.packets = buffer.packets();
+	header.stats = buffer.stats;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeColumn(out, buffer.x);
+	writeColumn(out, buffer.y);
+	writeColumn(out, buffer.z);
+	writeColumn(out, buffer.reflectivity);
+	writeColumn(out, buffer.tag);
+	writeColumn(out, buffer.line_id);
+	writeColumn(out, buffer.laser_id);
+	writeColumn(out, buffer.timestampOffset);
+	writeColumn(out, buffer.packetTimestamp);
+	writeColumn(out, buffer.packetFirstPoint);
+	out.close();
+	if(out.fail())
+	{
+		std::cerr << "Error writing raw points to " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadRawPoints(const std::string& filename, LivoxPointsBuffer& buffer)
+{
+	std::ifstream in(filename, std::ios::binary);
+	RawPointsHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if(in.fail() || std::memcmp(header.magic, RawPointsMagic, sizeof(header.magic)) != 0 || header.version != RawPointsVersion ||
+	   header.headerSize != sizeof(header))
+	{
+		std::cerr << "Not a raw points file " << filename << std::endl;
+		return false;
+	}
+	readColumn(in, buffer.x, header.points);
+	readColumn(in, buffer.y, header.points);
+	readColumn(in, buffer.z, header.points);
+	readColumn(in, buffer.reflectivity, header.points);
+	readColumn(in, buffer.tag, header.points);
+	readColumn(in, buffer.line_id, header.points);
+	readColumn(in, buffer.laser_id, header.points);
+	readColumn(in, buffer.timestampOffset, header.points);
+	readColumn(in, buffer.packetTimestamp, header.packets);
+	readColumn(in, buffer.packetFirstPoint, header.packets);
+	buffer.stats = header.stats;
+	if(in.fail())
+	{
+		std::cerr << "Truncated raw points file " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // namespace mandeye
@@ -1,62 +1,116 @@
 #include "utils/save_laz.h"
 #include "laszip/laszip_api.h"
+#include "utils/copc_octree.h"
+#include "utils/laz_chunk_table.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
-bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& buffer)
+namespace
 {
-	auto now = std::chrono::system_clock::now();
-	constexpr float scale = 0.0001f; // one tenth of millimeter
-	// find max
-	double max_x{std::numeric_limits<double>::lowest()};
-	double max_y{std::numeric_limits<double>::lowest()};
-	double max_z{std::numeric_limits<double>::lowest()};
+constexpr float scale = 0.0001f; // one tenth of millimeter
 
-	double min_x{std::numeric_limits<double>::max()};
-	double min_y{std::numeric_limits<double>::max()};
-	double min_z{std::numeric_limits<double>::max()};
+struct Bounds
+{
+	double min_x, min_y, min_z;
+	double max_x, max_y, max_z;
+};
 
-	for(auto& p : *buffer)
+//! bounds from the stats maintained while the buffer was filled, one pass over the coordinates for buffers without them
+Bounds computeBounds(const mandeye::LivoxPointsBuffer& buffer)
+{
+	const auto& stats = buffer.stats;
+	if(stats.points == buffer.size() && !buffer.empty())
 	{
-		double x = 0.001 * p.point.x;
-		double y = 0.001 * p.point.y;
-		double z = 0.001 * p.point.z;
-
-		max_x = std::max(max_x, x);
-		max_y = std::max(max_y, y);
-		max_z = std::max(max_z, z);
-
-		min_x = std::min(min_x, x);
-		min_y = std::min(min_y, y);
-		min_z = std::min(min_z, z);
+		return {0.001 * stats.minX, 0.001 * stats.minY, 0.001 * stats.minZ, 0.001 * stats.maxX, 0.001 * stats.maxY, 0.001 * stats.maxZ};
 	}
 
-	std::cout << "processing: " << filename << "points " << buffer->size() << std::endl;
+	// find max, on the integer columns so the loops vectorize
+	int32_t max_ix{std::numeric_limits<int32_t>::lowest()};
+	int32_t max_iy{std::numeric_limits<int32_t>::lowest()};
+	int32_t max_iz{std::numeric_limits<int32_t>::lowest()};
 
-	laszip_POINTER laszip_writer;
-	if(laszip_create(&laszip_writer))
+	int32_t min_ix{std::numeric_limits<int32_t>::max()};
+	int32_t min_iy{std::numeric_limits<int32_t>::max()};
+	int32_t min_iz{std::numeric_limits<int32_t>::max()};
+
+	const size_t size = buffer.size();
+	const int32_t* xs = buffer.x.data();
+	const int32_t* ys = buffer.y.data();
+	const int32_t* zs = buffer.z.data();
+	for(size_t i = 0; i < size; i++)
 	{
-		fprintf(stderr, "DLL ERROR: creating laszip writer\n");
-		return false;
+		max_ix = std::max(max_ix, xs[i]);
+		min_ix = std::min(min_ix, xs[i]);
 	}
+	for(size_t i = 0; i < size; i++)
+	{
+		max_iy = std::max(max_iy, ys[i]);
+		min_iy = std::min(min_iy, ys[i]);
+	}
+	for(size_t i = 0; i < size; i++)
+	{
+		max_iz = std::max(max_iz, zs[i]);
+		min_iz = std::min(min_iz, zs[i]);
+	}
+	return {0.001 * min_ix, 0.001 * min_iy, 0.001 * min_iz, 0.001 * max_ix, 0.001 * max_iy, 0.001 * max_iz};
+}
 
-	// get a pointer to the header of the writer so we can populate it
+//! how points are written, the same for every chunk of a file
+struct LasLayout
+{
+	mandeye::LasFormat format;
+	uint64_t timeBase; // ns, subtracted from the point timestamps in format 6
+	bool copc{false}; // reserves the COPC info VLR, format 6 only
+};
 
-	laszip_header* header;
+//! extra bytes of format 6, in this order: line_id, laser_id, tag
+constexpr laszip_U16 Format6ExtraBytes = 3;
+constexpr laszip_U16 Format6RecordLength = 30 + Format6ExtraBytes;
 
-	if(laszip_get_header_pointer(laszip_writer, &header))
+struct TimeRange
+{
+	uint64_t first; // ns
+	uint64_t last;
+};
+
+//! of the point timestamps, from the stats when they cover the buffer
+TimeRange timeRange(const mandeye::LivoxPointsBuffer& buffer)
+{
+	if(buffer.stats.points == buffer.size() && !buffer.empty())
 	{
-		fprintf(stderr, "DLL ERROR: getting header pointer from laszip writer\n");
-		return false;
+		return {buffer.stats.firstTimestamp, buffer.stats.lastTimestamp};
 	}
+	TimeRange range{buffer.empty() ? 0 : std::numeric_limits<uint64_t>::max(), 0};
+	buffer.forEachPacket([&](uint64_t timestamp, size_t first, size_t end) {
+		for(size_t i = first; i < end; i++)
+		{
+			range.first = std::min(range.first, timestamp + buffer.timestampOffset[i]);
+			range.last = std::max(range.last, timestamp + buffer.timestampOffset[i]);
+		}
+	});
+	return range;
+}
 
-	// populate the header
-	int step = 1;
-	if(buffer->size() > 4000000){ // this will likely never happen
-		step = ceil((double)buffer->size() / 2000000.0);
-	}
+//! points written for every step-th point of [first, end)
+size_t decimatedPoints(size_t first, size_t end, size_t step)
+{
+	return end > first ? (end - first + step - 1) / step : 0;
+}
 
-	int num_points = buffer->size() / step;
+//! earliest point timestamp
+uint64_t timeBase(const mandeye::LivoxPointsBuffer& buffer)
+{
+	return timeRange(buffer).first;
+}
 
+void fillHeader(laszip_header* header, const Bounds& bounds, laszip_U32 num_points, mandeye::LasFormat format = mandeye::LasFormat::Las12Format1)
+{
 	header->file_source_ID = 4711;
 	header->global_encoding = (1 << 0); // see LAS specification for details
 	header->version_major = 1;
@@ -65,35 +119,141 @@ bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& b
 	//    header->file_creation_year = 2013;
 	header->point_data_format = 1;
 	header->point_data_record_length = 0;
-	header->number_of_point_records = num_points;//buffer->size();
-	header->number_of_points_by_return[0] = num_points;//buffer->size();
+	header->number_of_point_records = num_points;
+	header->number_of_points_by_return[0] = num_points;
 	header->number_of_points_by_return[1] = 0;
 	header->point_data_record_length = 28;
+	if(format == mandeye::LasFormat::Las14Format6)
+	{
+		// time is relative to the time base, not adjusted GPS time; legacy counts stay 0 for format 6.
+		// LAS 1.4 requires the WKT bit for point formats 6 to 10, COPC readers check it
+		header->global_encoding = (1 << 4);
+		header->version_minor = 4;
+		header->header_size = 375;
+		header->offset_to_point_data = 375;
+		header->point_data_format = 6;
+		header->point_data_record_length = Format6RecordLength;
+		header->number_of_point_records = 0;
+		header->number_of_points_by_return[0] = 0;
+		header->extended_number_of_point_records = num_points;
+		header->extended_number_of_points_by_return[0] = num_points;
+	}
 	header->x_scale_factor = scale;
 	header->y_scale_factor = scale;
 	header->z_scale_factor = scale;
 
-	header->max_x = max_x;
-	header->min_x = min_x;
-	header->max_y = max_y;
-	header->min_y = min_y;
-	header->max_z = max_z;
-	header->min_z = min_z;
+	header->max_x = bounds.max_x;
+	header->min_x = bounds.min_x;
+	header->max_y = bounds.max_y;
+	header->min_y = bounds.min_y;
+	header->max_z = bounds.max_z;
+	header->min_z = bounds.min_z;
+}
 
-	// optional: use the bounding box and the scale factor to create a "good" offset
-	// open the writer
-	laszip_BOOL compress = (strstr(filename.c_str(), ".laz") != 0);
+//! LAS 1.4 and COPC structures patched into an assembled header
+constexpr size_t HeaderSizePosition = 94;
+constexpr size_t EvlrStartPosition = 235;
+constexpr size_t EvlrCountPosition = 243;
+constexpr size_t LegacyPointCountPosition = 107;
+constexpr size_t LegacyPointsByReturnPosition = 111;
+constexpr size_t PointCountPosition = 247;
+constexpr size_t PointsByReturnPosition = 255;
+constexpr size_t VlrHeaderSize = 54;
+constexpr size_t LaszipChunkSizePosition = 12; // in the payload of the LASzip VLR
+constexpr uint16_t CopcInfoSize = 160;
+constexpr uint16_t CopcHierarchyRecordId = 1000;
 
-	if(laszip_open_writer(laszip_writer, filename.c_str(), compress))
+#pragma pack(push, 1)
+struct CopcInfo
+{
+	double center_x, center_y, center_z;
+	double halfsize;
+	double spacing;
+	uint64_t root_hier_offset;
+	uint64_t root_hier_size;
+	double gpstime_minimum;
+	double gpstime_maximum;
+	uint64_t reserved[11];
+};
+
+struct CopcHierarchyEntry
+{
+	int32_t d, x, y, z;
+	uint64_t offset;
+	int32_t byteSize;
+	int32_t pointCount;
+};
+
+struct EvlrHeader
+{
+	uint16_t reserved;
+	char userId[16];
+	uint16_t recordId;
+	uint64_t recordLength;
+	char description[32];
+};
+#pragma pack(pop)
+static_assert(sizeof(CopcInfo) == CopcInfoSize && sizeof(CopcHierarchyEntry) == 32 && sizeof(EvlrHeader) == 60);
+
+template <typename T>
+void patch(std::string& bytes, size_t position, const T& value)
+{
+	std::memcpy(bytes.data() + position, &value, sizeof(value));
+}
+
+//! sets the point counts fillHeader put in an assembled header
+void patchPointCount(std::string& header, uint64_t points, mandeye::LasFormat format)
+{
+	if(format == mandeye::LasFormat::Las12Format1)
 	{
-		fprintf(stderr, "DLL ERROR: opening laszip writer for '%s'\n", filename.c_str());
-		return false;
+		patch(header, LegacyPointCountPosition, static_cast<uint32_t>(points));
+		patch(header, LegacyPointsByReturnPosition, static_cast<uint32_t>(points));
 	}
+	else
+	{
+		patch(header, PointCountPosition, points);
+		patch(header, PointsByReturnPosition, points);
+	}
+}
 
-	fprintf(stderr, "writing file '%s' %scompressed\n", filename.c_str(), (compress ? "" : "un"));
-
-	// get a pointer to the point of the writer that we will populate and write
+//! declares the extra bytes and the time base of format 6, between fillHeader and opening the writer
+bool prepareWriter(laszip_POINTER laszip_writer, const LasLayout& layout)
+{
+	if(layout.format != mandeye::LasFormat::Las14Format6)
+	{
+		return true;
+	}
+	uint8_t timeBase[sizeof(uint64_t)];
+	std::memcpy(timeBase, &layout.timeBase, sizeof(timeBase));
+	// the COPC info must be the first VLR, it is filled once the hierarchy is known
+	static const uint8_t copcInfo[CopcInfoSize] = {};
+	if(layout.copc && laszip_add_vlr(laszip_writer, "copc", 1, CopcInfoSize, "copc info", copcInfo))
+	{
+		fprintf(stderr, "DLL ERROR: adding the COPC info VLR\n");
+		return false;
+	}
+	// the native LAS 1.4 compressor puts every field in its own layer
+	if(laszip_request_native_extension(laszip_writer, 1) || laszip_add_attribute(laszip_writer, 0, "line_id", "scan line of the lidar", 1.0, 0.0) ||
+	   laszip_add_attribute(laszip_writer, 0, "laser_id", "index of the lidar", 1.0, 0.0) ||
+	   laszip_add_attribute(laszip_writer, 0, "tag", "Livox point tag", 1.0, 0.0) ||
+	   laszip_add_vlr(laszip_writer, "mandeye", 1, sizeof(timeBase), "time base, uint64 epoch ns", timeBase))
+	{
+		fprintf(stderr, "DLL ERROR: preparing LAS 1.4 point format 6\n");
+		return false;
+	}
+	return true;
+}
 
+//! writes every step-th point of [first, end)
+//! @param updateInventory keeps point count and bounding box for the header, for files opened before the points are known
+bool writePoints(laszip_POINTER laszip_writer,
+				 const mandeye::LivoxPointsBuffer& buffer,
+				 size_t first,
+				 size_t end,
+				 size_t step,
+				 const LasLayout& layout = {mandeye::LasFormat::Las12Format1, 0},
+				 bool updateInventory = false)
+{
 	laszip_point* point;
 	if(laszip_get_point_pointer(laszip_writer, &point))
 	{
@@ -104,20 +264,38 @@ bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& b
 	laszip_I64 p_count = 0;
 	laszip_F64 coordinates[3];
 
-
-	//for(int i = 0; i < buffer->size(); i++)
-	for(int i = 0; i < buffer->size(); i += step)
+	// packet of the first point
+	const auto& firstPoints = buffer.packetFirstPoint;
+	size_t packet = std::upper_bound(firstPoints.begin(), firstPoints.end(), static_cast<uint32_t>(first)) - firstPoints.begin();
+	packet = packet > 0 ? packet - 1 : 0;
+	const size_t packets = buffer.packets();
+	for(size_t i = first; i < end; i += step)
 	{
-
-		const auto& p = buffer->at(i);
-		point->intensity = p.point.reflectivity;
-		point->gps_time = p.timestamp * 1e-9;
-		point->user_data = p.laser_id;
-		point->classification = p.point.tag;
+		while(packet + 1 < packets && firstPoints[packet + 1] <= i)
+		{
+			packet++;
+		}
+		const uint64_t timestamp = buffer.packetTimestamp[packet] + buffer.timestampOffset[i];
+		point->intensity = buffer.reflectivity[i];
+		if(layout.format == mandeye::LasFormat::Las14Format6)
+		{
+			point->gps_time = static_cast<int64_t>(timestamp - layout.timeBase) * 1e-9; // streamed files may go slightly below their base
+			point->extended_return_number = mandeye::livoxReturnIndex(buffer.tag[i]) + 1;
+			point->extended_number_of_returns = point->extended_return_number;
+			point->extra_bytes[0] = buffer.line_id[i];
+			point->extra_bytes[1] = buffer.laser_id[i];
+			point->extra_bytes[2] = buffer.tag[i];
+		}
+		else
+		{
+			point->gps_time = timestamp * 1e-9;
+			point->user_data = buffer.laser_id[i];
+			point->classification = buffer.tag[i];
+		}
 		p_count++;
-		coordinates[0] = 0.001 * p.point.x;
-		coordinates[1] = 0.001 * p.point.y;
-		coordinates[2] = 0.001 * p.point.z;
+		coordinates[0] = 0.001 * buffer.x[i];
+		coordinates[1] = 0.001 * buffer.y[i];
+		coordinates[2] = 0.001 * buffer.z[i];
 		if(laszip_set_coordinates(laszip_writer, coordinates))
 		{
 			fprintf(stderr, "DLL ERROR: setting coordinates for point %I64d\n", p_count);
@@ -129,8 +307,183 @@ bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& b
 			fprintf(stderr, "DLL ERROR: writing point %I64d\n", p_count);
 			return false;
 		}
+
+		if(updateInventory && laszip_update_inventory(laszip_writer))
+		{
+			fprintf(stderr, "DLL ERROR: updating inventory for point %I64d\n", p_count);
+			return false;
+		}
+	}
+	return true;
+}
+
+//! LAS header fields used to cut a compressed stream apart
+constexpr size_t OffsetToPointDataPosition = 96;
+
+uint32_t offsetToPointData(const std::string& file)
+{
+	uint32_t offset = 0;
+	if(file.size() >= OffsetToPointDataPosition + sizeof(offset))
+	{
+		std::memcpy(&offset, file.data() + OffsetToPointDataPosition, sizeof(offset));
+	}
+	return offset;
+}
+
+//! Compresses every step-th point of [first, end) as one LASzip chunk in a LAZ file in memory
+//! @param filePoints points of the whole file, for the header
+//! @param header if not null, receives the file header and VLRs, written before any point
+//! @param chunk receives the compressed bytes of the chunk
+bool compressChunk(const mandeye::LivoxPointsBuffer& buffer,
+				   const Bounds& bounds,
+				   const LasLayout& layout,
+				   size_t filePoints,
+				   size_t first,
+				   size_t end,
+				   size_t step,
+				   std::string* header,
+				   std::string& chunk)
+{
+	const size_t chunkPoints = decimatedPoints(first, end, step);
+	laszip_POINTER laszip_writer;
+	if(laszip_create(&laszip_writer))
+	{
+		fprintf(stderr, "DLL ERROR: creating laszip writer\n");
+		return false;
+	}
+	laszip_header* lasHeader;
+	std::ostringstream stream(std::ios::out | std::ios::binary);
+	bool ok = !laszip_get_header_pointer(laszip_writer, &lasHeader);
+	if(ok)
+	{
+		// the writer gets the count of this chunk, the kept header copy gets the one of the whole file
+		fillHeader(lasHeader, bounds, static_cast<laszip_U32>(chunkPoints), layout.format);
+		const size_t chunkSize = std::max(mandeye::LazChunkPoints, chunkPoints); // COPC nodes can be larger
+		ok = prepareWriter(laszip_writer, layout) && !laszip_set_chunk_size(laszip_writer, static_cast<laszip_U32>(chunkSize)) &&
+			 !laszip_open_writer_stream(laszip_writer, stream, 1, 0);
+	}
+	if(ok && header != nullptr)
+	{
+		const std::string opened = stream.str();
+		*header = opened.substr(0, offsetToPointData(opened));
+		ok = header->size() >= PointsByReturnPosition + sizeof(uint64_t);
+		if(ok)
+		{
+			patchPointCount(*header, filePoints, layout.format);
+		}
+	}
+	ok = ok && writePoints(laszip_writer, buffer, first, end, step, layout);
+	ok = !laszip_close_writer(laszip_writer) && ok;
+	laszip_destroy(laszip_writer);
+	if(!ok)
+	{
+		fprintf(stderr, "DLL ERROR: compressing points %zu to %zu\n", first, end);
+		return false;
+	}
+
+	// point data starts with the position of the chunk table, the chunk follows up to the table
+	const std::string file = stream.str();
+	const size_t chunkStart = offsetToPointData(file) + sizeof(int64_t);
+	int64_t chunkTable = 0;
+	if(chunkStart > file.size())
+	{
+		return false;
+	}
+	std::memcpy(&chunkTable, file.data() + chunkStart - sizeof(int64_t), sizeof(chunkTable));
+	if(chunkTable < static_cast<int64_t>(chunkStart) || chunkTable > static_cast<int64_t>(file.size()))
+	{
+		fprintf(stderr, "LAZ ERROR: no chunk table in compressed chunk\n");
+		return false;
+	}
+	chunk = file.substr(chunkStart, chunkTable - chunkStart);
+	return true;
+}
+} // namespace
+
+mandeye::LasFormat mandeye::lasFormatFromString(const std::string& format)
+{
+	if(format == "6")
+	{
+		return LasFormat::Las14Format6;
+	}
+	if(format == "copc")
+	{
+		return LasFormat::Copc;
+	}
+	if(format != "1")
+	{
+		std::cerr << "Unknown LAS point format '" << format << "', writing point format 1" << std::endl;
+	}
+	return LasFormat::Las12Format1;
+}
+
+const char* mandeye::lazExtension(LasFormat format)
+{
+	return format == LasFormat::Copc ? ".copc.laz" : ".laz";
+}
+
+size_t mandeye::lazDecimationStep(size_t points)
+{
+	return points > 4000000 ? static_cast<size_t>(ceil(points / 2000000.0)) : 1; // this will likely never happen
+}
+
+bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& buffer, LasFormat format)
+{
+	if(format == LasFormat::Copc)
+	{
+		return saveCopc(filename, buffer, 1);
+	}
+	auto now = std::chrono::system_clock::now();
+	const size_t size = buffer->size();
+	const Bounds bounds = computeBounds(*buffer);
+
+	std::cout << "processing: " << filename << "points " << size << std::endl;
+
+	laszip_POINTER laszip_writer;
+	if(laszip_create(&laszip_writer))
+	{
+		fprintf(stderr, "DLL ERROR: creating laszip writer\n");
+		return false;
+	}
+
+	// get a pointer to the header of the writer so we can populate it
+
+	laszip_header* header;
+
+	if(laszip_get_header_pointer(laszip_writer, &header))
+	{
+		fprintf(stderr, "DLL ERROR: getting header pointer from laszip writer\n");
+		return false;
+	}
+
+	// populate the header
+	const size_t step = lazDecimationStep(size);
+	const size_t num_points = decimatedPoints(0, size, step);
+	fillHeader(header, bounds, static_cast<laszip_U32>(num_points), format);
+	const LasLayout layout{format, timeBase(*buffer)};
+	if(!prepareWriter(laszip_writer, layout))
+	{
+		return false;
 	}
 
+	// optional: use the bounding box and the scale factor to create a "good" offset
+	// open the writer
+	laszip_BOOL compress = (strstr(filename.c_str(), ".laz") != 0);
+
+	if(laszip_open_writer(laszip_writer, filename.c_str(), compress))
+	{
+		fprintf(stderr, "DLL ERROR: opening laszip writer for '%s'\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "writing file '%s' %scompressed\n", filename.c_str(), (compress ? "" : "un"));
+
+	if(!writePoints(laszip_writer, *buffer, 0, size, step, layout))
+	{
+		return false;
+	}
+
+	laszip_I64 p_count = 0;
 	if(laszip_get_point_count(laszip_writer, &p_count))
 	{
 		fprintf(stderr, "DLL ERROR: getting point count\n");
@@ -158,4 +511,419 @@ bool mandeye::saveLaz(const std::string& filename, const LivoxPointsBufferPtr& b
 	std::cout << "exportLaz DONE" << std::endl;
 	std::cout << "time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count() << "ms" << std::endl;
 	return true;
-}
\ No newline at end of file
+}
+
+bool mandeye::saveLazParallel(const std::string& filename, const LivoxPointsBufferPtr& buffer, unsigned threads, LasFormat format)
+{
+	if(format == LasFormat::Copc)
+	{
+		return saveCopc(filename, buffer, threads);
+	}
+	const size_t size = buffer->size();
+	const size_t step = lazDecimationStep(size);
+	const size_t points = decimatedPoints(0, size, step);
+	const size_t chunks = (points + LazChunkPoints - 1) / LazChunkPoints;
+	if(threads <= 1 || chunks <= 1 || strstr(filename.c_str(), ".laz") == nullptr)
+	{
+		return saveLaz(filename, buffer, format);
+	}
+	auto now = std::chrono::system_clock::now();
+	const Bounds bounds = computeBounds(*buffer);
+	const LasLayout layout{format, timeBase(*buffer)};
+	std::cout << "processing: " << filename << "points " << size << " on " << threads << " threads" << std::endl;
+
+	// every chunk restarts the entropy coder, so chunks compress independently and are concatenated in order
+	std::string header;
+	std::vector<std::string> compressed(chunks);
+	std::atomic<size_t> nextChunk{0};
+	std::atomic<bool> failed{false};
+	std::vector<std::thread> workers;
+	for(unsigned t = 0; t < std::min<size_t>(threads, chunks); t++)
+	{
+		workers.emplace_back([&]() {
+			for(size_t c = nextChunk++; c < chunks && !failed; c = nextChunk++)
+			{
+				// chunk c holds decimated points [c * LazChunkPoints, (c + 1) * LazChunkPoints)
+				const size_t first = c * LazChunkPoints * step;
+				const size_t end = std::min(first + LazChunkPoints * step, size);
+				if(!compressChunk(*buffer, bounds, layout, points, first, end, step, c == 0 ? &header : nullptr, compressed[c]))
+				{
+					failed = true;
+				}
+			}
+		});
+	}
+	for(auto& worker : workers)
+	{
+		worker.join();
+	}
+	if(failed || header.empty())
+	{
+		fprintf(stderr, "LAZ ERROR: compressing '%s' failed\n", filename.c_str());
+		return false;
+	}
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	std::vector<uint32_t> chunkBytes(chunks);
+	int64_t chunkTable = header.size() + sizeof(int64_t);
+	for(size_t c = 0; c < chunks; c++)
+	{
+		chunkBytes[c] = static_cast<uint32_t>(compressed[c].size());
+		chunkTable += chunkBytes[c];
+	}
+	file.write(header.data(), header.size());
+	file.write(reinterpret_cast<const char*>(&chunkTable), sizeof(chunkTable));
+	for(const auto& chunk : compressed)
+	{
+		file.write(chunk.data(), chunk.size());
+	}
+	writeLazChunkTable(file, chunkBytes);
+	file.close();
+	if(file.fail())
+	{
+		fprintf(stderr, "LAZ ERROR: writing '%s' failed\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "successfully written %zu points\n", points);
+	std::cout << "exportLaz DONE" << std::endl;
+	std::cout << "time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count() << "ms" << std::endl;
+	return true;
+}
+
+bool mandeye::saveCopc(const std::string& filename, const LivoxPointsBufferPtr& buffer, unsigned threads)
+{
+	const size_t size = buffer->size();
+	if(size == 0)
+	{
+		return saveLaz(filename, buffer, LasFormat::Las14Format6); // no octree without points
+	}
+	auto now = std::chrono::system_clock::now();
+	threads = std::max(1u, threads);
+	std::cout << "processing: " << filename << "points " << size << " as COPC on " << threads << " threads" << std::endl;
+	const CopcOctree octree = buildCopcOctree(*buffer, threads);
+	const Bounds bounds = computeBounds(*buffer);
+	const TimeRange times = timeRange(*buffer);
+	const LasLayout layout{LasFormat::Las14Format6, times.first, true};
+
+	// one LASzip chunk per node, the root comes first and provides the header
+	const size_t nodes = octree.nodes.size();
+	std::string header;
+	std::vector<std::string> compressed(nodes);
+	std::atomic<size_t> nextNode{0};
+	std::atomic<bool> failed{false};
+	std::vector<std::thread> workers;
+	for(unsigned t = 0; t < std::min<size_t>(threads, nodes); t++)
+	{
+		workers.emplace_back([&]() {
+			for(size_t n = nextNode++; n < nodes && !failed; n = nextNode++)
+			{
+				const auto nodeBuffer = gatherCopcNode(*buffer, octree.nodes[n]);
+				if(!compressChunk(*nodeBuffer, bounds, layout, size, 0, nodeBuffer->size(), 1, n == 0 ? &header : nullptr, compressed[n]))
+				{
+					failed = true;
+				}
+			}
+		});
+	}
+	for(auto& worker : workers)
+	{
+		worker.join();
+	}
+	uint16_t headerSize = 0;
+	if(!failed && header.size() >= HeaderSizePosition + sizeof(headerSize))
+	{
+		std::memcpy(&headerSize, header.data() + HeaderSizePosition, sizeof(headerSize));
+	}
+	const size_t laszipVlr = header.find("laszip encoded");
+	const size_t copcInfoPosition = headerSize + VlrHeaderSize;
+	if(failed || laszipVlr == std::string::npos || header.size() < copcInfoPosition + CopcInfoSize || header.compare(headerSize + 2, 4, "copc") != 0)
+	{
+		fprintf(stderr, "LAZ ERROR: compressing COPC '%s' failed\n", filename.c_str());
+		return false;
+	}
+
+	// node chunks have their own sizes, LASzip marks that with the largest chunk size
+	patch(header, laszipVlr - 2 + VlrHeaderSize + LaszipChunkSizePosition, std::numeric_limits<uint32_t>::max());
+	std::vector<uint32_t> chunkBytes(nodes);
+	std::vector<uint32_t> chunkPoints(nodes);
+	std::vector<CopcHierarchyEntry> hierarchy(nodes);
+	uint64_t offset = header.size() + sizeof(int64_t);
+	for(size_t n = 0; n < nodes; n++)
+	{
+		const auto& node = octree.nodes[n];
+		chunkBytes[n] = static_cast<uint32_t>(compressed[n].size());
+		chunkPoints[n] = static_cast<uint32_t>(node.points.size());
+		hierarchy[n] = {node.key.d, node.key.x, node.key.y, node.key.z, offset, static_cast<int32_t>(chunkBytes[n]), static_cast<int32_t>(chunkPoints[n])};
+		offset += chunkBytes[n];
+	}
+	const int64_t chunkTable = static_cast<int64_t>(offset);
+	std::ostringstream table(std::ios::out | std::ios::binary);
+	writeLazChunkTable(table, chunkBytes, chunkPoints);
+	const std::string tableBytes = table.str();
+	const uint64_t evlrStart = offset + tableBytes.size();
+
+	EvlrHeader evlr{};
+	std::strncpy(evlr.userId, "copc", sizeof(evlr.userId));
+	evlr.recordId = CopcHierarchyRecordId;
+	evlr.recordLength = hierarchy.size() * sizeof(CopcHierarchyEntry);
+	std::strncpy(evlr.description, "EPT hierarchy", sizeof(evlr.description));
+
+	CopcInfo info{};
+	info.center_x = octree.center[0];
+	info.center_y = octree.center[1];
+	info.center_z = octree.center[2];
+	info.halfsize = octree.halfSize;
+	info.spacing = octree.spacing;
+	info.root_hier_offset = evlrStart + sizeof(evlr);
+	info.root_hier_size = evlr.recordLength;
+	info.gpstime_minimum = 0;
+	info.gpstime_maximum = static_cast<int64_t>(times.last - times.first) * 1e-9;
+	patch(header, copcInfoPosition, info);
+	patch(header, EvlrStartPosition, evlrStart);
+	patch(header, EvlrCountPosition, uint32_t{1});
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write(header.data(), header.size());
+	file.write(reinterpret_cast<const char*>(&chunkTable), sizeof(chunkTable));
+	for(const auto& chunk : compressed)
+	{
+		file.write(chunk.data(), chunk.size());
+	}
+	file.write(tableBytes.data(), tableBytes.size());
+	file.write(reinterpret_cast<const char*>(&evlr), sizeof(evlr));
+	file.write(reinterpret_cast<const char*>(hierarchy.data()), evlr.recordLength);
+	file.close();
+	if(file.fail())
+	{
+		fprintf(stderr, "LAZ ERROR: writing '%s' failed\n", filename.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "successfully written %zu points in %zu octree nodes\n", size, nodes);
+	std::cout << "exportLaz DONE" << std::endl;
+	std::cout << "time: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - now).count() << "ms" << std::endl;
+	return true;
+}
+
+bool mandeye::loadLaz(const std::string& filename, LivoxPointsBuffer& buffer)
+{
+	laszip_POINTER laszip_reader;
+	laszip_BOOL compressed = 0;
+	if(laszip_create(&laszip_reader) || laszip_open_reader(laszip_reader, filename.c_str(), &compressed))
+	{
+		fprintf(stderr, "DLL ERROR: opening laszip reader for '%s'\n", filename.c_str());
+		return false;
+	}
+	laszip_header* header;
+	laszip_point* point;
+	laszip_get_header_pointer(laszip_reader, &header);
+	laszip_get_point_pointer(laszip_reader, &point);
+
+	// format 6 files of saveLaz keep line_id, laser_id and tag in extra bytes and time relative to a base
+	const bool format6 = header->point_data_format >= 6 && point->num_extra_bytes >= Format6ExtraBytes;
+	uint64_t base = 0;
+	for(laszip_U32 v = 0; v < header->number_of_variable_length_records; v++)
+	{
+		const auto& vlr = header->vlrs[v];
+		if(std::strncmp(vlr.user_id, "mandeye", sizeof(vlr.user_id)) == 0 && vlr.record_id == 1 && vlr.record_length_after_header >= sizeof(base))
+		{
+			std::memcpy(&base, vlr.data, sizeof(base));
+		}
+	}
+	const uint64_t count = header->number_of_point_records != 0 ? header->number_of_point_records : header->extended_number_of_point_records;
+	buffer.reserve(buffer.size() + count, buffer.packets() + count / LivoxMaxPointsPerPacket + 1);
+
+	bool ok = true;
+	uint64_t packetTimestamp = 0;
+	bool packetOpen = false;
+	laszip_F64 coordinates[3];
+	for(uint64_t p = 0; ok && p < count; p++)
+	{
+		ok = !laszip_read_point(laszip_reader) && !laszip_get_coordinates(laszip_reader, coordinates);
+		const int64_t time = std::llround(point->gps_time * 1e9);
+		const uint64_t timestamp = header->point_data_format >= 6 ? base + time : time;
+		// points share a packet while their offset fits
+		if(!packetOpen || timestamp < packetTimestamp || timestamp - packetTimestamp > std::numeric_limits<uint32_t>::max())
+		{
+			buffer.beginPacket(timestamp);
+			packetTimestamp = timestamp;
+			packetOpen = true;
+		}
+		buffer.push(static_cast<int32_t>(std::lround(coordinates[0] * 1000)),
+					static_cast<int32_t>(std::lround(coordinates[1] * 1000)),
+					static_cast<int32_t>(std::lround(coordinates[2] * 1000)),
+					static_cast<uint8_t>(point->intensity),
+					format6 ? point->extra_bytes[2] : point->classification,
+					format6 ? point->extra_bytes[0] : 0,
+					format6 ? point->extra_bytes[1] : point->user_data,
+					static_cast<uint32_t>(timestamp - packetTimestamp));
+	}
+	laszip_close_reader(laszip_reader);
+	laszip_destroy(laszip_reader);
+	if(!ok)
+	{
+		fprintf(stderr, "DLL ERROR: reading '%s'\n", filename.c_str());
+	}
+	return ok;
+}
+
+bool mandeye::LazStreamFile::moveTo(const std::filesystem::path& destination)
+{
+	if(!m_closed.get())
+	{
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(m_path, destination, error);
+	if(error)
+	{
+		// another file system, the stream file stays until its copy is complete
+		error.clear();
+		std::filesystem::copy_file(m_path, destination, std::filesystem::copy_options::overwrite_existing, error);
+		if(error)
+		{
+			std::error_code ignored;
+			std::filesystem::remove(destination, ignored);
+		}
+	}
+	if(error)
+	{
+		std::cerr << "LAZ ERROR: moving '" << m_path << "' to '" << destination << "': " << error.message() << std::endl;
+		return false;
+	}
+	std::error_code removeError;
+	std::filesystem::remove(m_path, removeError); // nothing to do after a rename
+	return true;
+}
+
+mandeye::LazStream::LazStream(std::filesystem::path directory, LasFormat format)
+	: m_directory(std::move(directory))
+	, m_format(format == LasFormat::Copc ? LasFormat::Las14Format6 : format)
+	, m_currentPath(m_directory / "livox_stream_0.laz")
+	, m_thread(&LazStream::compressorThread, this)
+{ }
+
+mandeye::LazStream::~LazStream()
+{
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_done = true;
+	}
+	m_condition.notify_one();
+	if(m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void mandeye::LazStream::push(LivoxPointsBufferConstPtr block)
+{
+	if(!block || block->empty())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_queuedPoints += block->size();
+	m_currentStats.merge(block->stats);
+	m_items.push_back(Item{m_currentPath, std::move(block), {}});
+	m_condition.notify_one();
+}
+
+std::shared_ptr<mandeye::LazStreamFile> mandeye::LazStream::rotate()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	if(m_currentStats.points == 0)
+	{
+		return nullptr; // no block was pushed, so no file was opened
+	}
+	Item item{m_currentPath, nullptr, {}};
+	auto file = std::make_shared<LazStreamFile>(m_currentPath, item.closed.get_future().share(), m_currentStats);
+	m_currentStats = {};
+	m_items.push_back(std::move(item));
+	m_currentPath = m_directory / ("livox_stream_" + std::to_string(++m_files) + ".laz");
+	m_condition.notify_one();
+	return file;
+}
+
+void mandeye::LazStream::discard()
+{
+	std::lock_guard<std::mutex> lck(m_mutex);
+	m_currentStats = {};
+	Item item{m_currentPath, nullptr, {}};
+	item.discard = true;
+	m_items.push_back(std::move(item));
+	m_currentPath = m_directory / ("livox_stream_" + std::to_string(++m_files) + ".laz");
+	m_condition.notify_one();
+}
+
+void mandeye::LazStream::compressorThread()
+{
+	laszip_POINTER laszip_writer = nullptr;
+	bool ok = true;
+	LasLayout layout{m_format, 0};
+	const auto open = [&](const std::filesystem::path& path, const LivoxPointsBufferConstPtr& firstBlock) {
+		laszip_header* header;
+		ok = !laszip_create(&laszip_writer) && !laszip_get_header_pointer(laszip_writer, &header);
+		if(ok)
+		{
+			// count and bounding box come from the inventory when the file is closed
+			fillHeader(header, Bounds{}, 0, m_format);
+			layout.timeBase = firstBlock ? timeBase(*firstBlock) : 0;
+			ok = prepareWriter(laszip_writer, layout) && !laszip_open_writer(laszip_writer, path.c_str(), 1);
+		}
+		if(!ok)
+		{
+			fprintf(stderr, "DLL ERROR: opening laszip writer for '%s'\n", path.c_str());
+		}
+	};
+	const auto close = [&]() {
+		ok = !laszip_close_writer(laszip_writer) && ok;
+		laszip_destroy(laszip_writer);
+		laszip_writer = nullptr;
+	};
+
+	while(true)
+	{
+		Item item;
+		{
+			std::unique_lock<std::mutex> lck(m_mutex);
+			m_condition.wait(lck, [this]() { return m_done || !m_items.empty(); });
+			if(m_items.empty())
+			{
+				break; // done
+			}
+			item = std::move(m_items.front());
+			m_items.pop_front();
+		}
+		if(laszip_writer == nullptr && item.block)
+		{
+			ok = true;
+			open(item.path, item.block);
+		}
+		if(item.block)
+		{
+			if(ok && !writePoints(laszip_writer, *item.block, 0, item.block->size(), 1, layout, true))
+			{
+				ok = false;
+			}
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_queuedPoints -= item.block->size();
+			continue;
+		}
+		if(laszip_writer != nullptr)
+		{
+			close();
+		}
+		if(item.discard)
+		{
+			std::error_code error;
+			std::filesystem::remove(item.path, error);
+		}
+		item.closed.set_value(ok);
+	}
+	if(laszip_writer != nullptr)
+	{
+		close(); // points of an unsaved chunk stay on disk
+	}
+}
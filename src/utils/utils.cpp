@@ -1,5 +1,9 @@
 #include "utils/utils.h"
 #include "state_management.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace utils
 {
@@ -34,10 +38,19 @@ void blinkLed(mandeye::LED led, std::chrono::milliseconds mills) {
 	std::this_thread::sleep_for(mills);
 }
 
-void syncDisk() {
-	if (system("sync")) {
-		std::cerr << "Error syncing disk\n";
+bool syncFilesystem(const std::string& path) {
+	const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "Error opening " << path << " for sync: " << strerror(errno) << ", syncing every filesystem" << std::endl;
+		sync();
+		return false;
 	}
+	const bool synced = syncfs(fd) == 0;
+	if (!synced) {
+		std::cerr << "Error syncing " << path << ": " << strerror(errno) << std::endl;
+	}
+	close(fd);
+	return synced;
 }
 
 std::vector<int> getIntListFromEnvVar(const std::string& env, const std::string& def)
@@ -0,0 +1,108 @@
+#include "utils/voxel_downsampler.h"
+#include <algorithm>
+
+namespace mandeye
+{
+
+namespace
+{
+// 21 bits per axis, +-1M voxels around the origin
+constexpr int64_t AxisBias = 1 << 20;
+constexpr uint64_t AxisMask = (uint64_t(1) << 21) - 1;
+
+int64_t floorDiv(int32_t value, int64_t divisor)
+{
+	const int64_t q = value / divisor;
+	return (value % divisor != 0 && value < 0) ? q - 1 : q;
+}
+
+//! Fibonacci hashing, the top bits of the product are the best mixed
+size_t hashKey(uint64_t key, int bits)
+{
+	return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+} // namespace
+
+VoxelDownsampler::VoxelDownsampler(const VoxelGridConfig& config)
+	: m_config(config)
+{
+	m_config.pointsPerVoxel = std::max<uint8_t>(m_config.pointsPerVoxel, 1);
+	if(enabled())
+	{
+		m_keys.assign(InitialCapacity, EmptyKey);
+		m_counts.assign(InitialCapacity, 0);
+		m_mask = InitialCapacity - 1;
+		m_bits = InitialBits;
+	}
+}
+
+uint64_t VoxelDownsampler::voxelKey(int32_t x, int32_t y, int32_t z) const
+{
+	const uint64_t vx = static_cast<uint64_t>(floorDiv(x, m_config.leafSize) + AxisBias) & AxisMask;
+	const uint64_t vy = static_cast<uint64_t>(floorDiv(y, m_config.leafSize) + AxisBias) & AxisMask;
+	const uint64_t vz = static_cast<uint64_t>(floorDiv(z, m_config.leafSize) + AxisBias) & AxisMask;
+	return (vx << 42) | (vy << 21) | vz;
+}
+
+bool VoxelDownsampler::accept(int32_t x, int32_t y, int32_t z)
+{
+	if(!enabled())
+	{
+		return true;
+	}
+	const uint64_t key = voxelKey(x, y, z);
+	size_t i = hashKey(key, m_bits);
+	while(m_keys[i] != EmptyKey)
+	{
+		if(m_keys[i] == key)
+		{
+			if(m_counts[i] >= m_config.pointsPerVoxel)
+			{
+				return false;
+			}
+			m_counts[i]++;
+			return true;
+		}
+		i = (i + 1) & m_mask;
+	}
+	m_keys[i] = key;
+	m_counts[i] = 1;
+	if(++m_occupied * 2 > m_keys.size())
+	{
+		grow();
+	}
+	return true;
+}
+
+void VoxelDownsampler::clear()
+{
+	std::fill(m_keys.begin(), m_keys.end(), EmptyKey);
+	m_occupied = 0;
+}
+
+void VoxelDownsampler::grow()
+{
+	std::vector<uint64_t> keys(m_keys.size() * 2, EmptyKey);
+	std::vector<uint8_t> counts(m_counts.size() * 2, 0);
+	const size_t mask = keys.size() - 1;
+	for(size_t j = 0; j < m_keys.size(); j++)
+	{
+		if(m_keys[j] == EmptyKey)
+		{
+			continue;
+		}
+		size_t i = hashKey(m_keys[j], m_bits + 1);
+		while(keys[i] != EmptyKey)
+		{
+			i = (i + 1) & mask;
+		}
+		keys[i] = m_keys[j];
+		counts[i] = m_counts[j];
+	}
+	m_keys.swap(keys);
+	m_counts.swap(counts);
+	m_mask = mask;
+	m_bits++;
+}
+
+} // namespace mandeye